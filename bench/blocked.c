@@ -0,0 +1,140 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "blocked.h"
+#include "physics.h"
+#include "threadpool.h"
+
+#define MIN_N 64
+#define DEFAULT_MAX_N 4096
+
+// The unblocked LU walks U by columns and takes minutes at the top of the
+// range, so it stops here unless asked for explicitly.
+#define DEFAULT_MAX_LU_N 2048
+
+// Roughly how many flops each measurement should cover.
+#define FLOP_BUDGET 2e9
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int repetitions(double flops) {
+  int count = (int)(FLOP_BUDGET / flops);
+  return count < 1 ? 1 : count;
+}
+
+// Largest difference between two factorisations' lower triangles,
+// relative to the largest entry.
+static double factorDifference(size_t n, const float* X, const float* Y) {
+  double worst = 0, scale = 0;
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j <= i; j++) {
+      worst = fmax(worst, fabs(X[i * n + j] - Y[i * n + j]));
+      scale = fmax(scale, fabs(X[i * n + j]));
+    }
+  }
+  return worst / scale;
+}
+
+// Every factorisation starts from a fresh copy of the same mass matrix;
+// the O(n^2) copy is inside the timing for all of them.
+// usage: bench_blocked [max n] [max n for lu] [threads]
+int main(int argc, char** argv) {
+  size_t maxN = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_MAX_N;
+  size_t maxLU = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_MAX_LU_N;
+  int threads = argc > 3 ? atoi(argv[3]) : hardwareThreads();
+
+  struct ThreadPool* pool = createThreadPool(threads, 0);
+
+  printf("%d threads for the threaded column, GFLOP/s counts n^3/3 (ldlt) and 2n^3/3 (lu)\n", threadPoolWorkers(pool));
+  printf("%6s %12s %12s %12s %12s %9s %9s %9s %11s\n", "n", "lu GF/s", "ldlt GF/s", "blocked", "threaded",
+         "vs lu", "vs ldlt", "threads x", "difference");
+
+  for (size_t n = MIN_N; n <= maxN; n *= 2) {
+    float* thetas = (float*)malloc(n * sizeof(float));
+    float* A = (float*)malloc(n * n * sizeof(float));
+    float* work = (float*)malloc(n * n * sizeof(float));
+    float* reference = (float*)malloc(n * n * sizeof(float));
+    float* L = (float*)malloc(n * n * sizeof(float));
+    float* U = (float*)malloc(n * n * sizeof(float));
+    float* scratch = (float*)malloc(BLOCKED_PANEL * n * sizeof(float));
+
+    srand((unsigned)n);
+    for (size_t i = 0; i < n; i++) {
+      thetas[i] = 6.2831853f * rand() / RAND_MAX;
+    }
+    createMatrixA(n, thetas, A);
+
+    double ldltFlops = (double)n * n * n / 3.0;
+    double luFlops = 2.0 * ldltFlops;
+
+    double luRate = 0;
+    if (n <= maxLU) {
+      int reps = repetitions(luFlops);
+      double start = now();
+      for (int r = 0; r < reps; r++) {
+        memcpy(work, A, n * n * sizeof(float));
+        lu_decompose(n, work, L, U);
+      }
+      luRate = luFlops * reps / (now() - start) * 1e-9;
+    }
+
+    int reps = repetitions(ldltFlops);
+    double start = now();
+    for (int r = 0; r < reps; r++) {
+      memcpy(reference, A, n * n * sizeof(float));
+      ldlt_decompose(n, reference);
+    }
+    double ldltRate = ldltFlops * reps / (now() - start) * 1e-9;
+
+    start = now();
+    for (int r = 0; r < reps; r++) {
+      memcpy(work, A, n * n * sizeof(float));
+      blocked_ldlt_decompose(n, work, scratch, NULL);
+    }
+    double blockedRate = ldltFlops * reps / (now() - start) * 1e-9;
+
+    start = now();
+    for (int r = 0; r < reps; r++) {
+      memcpy(work, A, n * n * sizeof(float));
+      blocked_ldlt_decompose(n, work, scratch, pool);
+    }
+    double threadedRate = ldltFlops * reps / (now() - start) * 1e-9;
+
+    char vsLU[16];
+    if (luRate > 0) {
+      snprintf(vsLU, sizeof(vsLU), "%.1fx", 2.0 * blockedRate / luRate);
+    } else {
+      snprintf(vsLU, sizeof(vsLU), "-");
+    }
+
+    char luColumn[16];
+    if (luRate > 0) {
+      snprintf(luColumn, sizeof(luColumn), "%.3f", luRate);
+    } else {
+      snprintf(luColumn, sizeof(luColumn), "skipped");
+    }
+
+    printf("%6zu %12s %12.3f %12.3f %12.3f %9s %8.1fx %8.1fx %11.2e\n", n, luColumn, ldltRate, blockedRate, threadedRate,
+           vsLU, blockedRate / ldltRate, threadedRate / blockedRate, factorDifference(n, reference, work));
+
+    free(scratch);
+    free(U);
+    free(L);
+    free(reference);
+    free(work);
+    free(A);
+    free(thetas);
+  }
+
+  destroyThreadPool(pool);
+  return 0;
+}
@@ -0,0 +1,99 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "ensemble.h"
+#include "physics.h"
+
+#define DEFAULT_LINKS 2
+#define DEFAULT_CHAINS 100000
+#define DEFAULT_STEPS 100
+
+#define TIME_STEP 0.0166f
+#define BASE_THETA 2.35619449f
+#define BASE_OMEGA 0.9f
+#define PERTURBATION 1e-4f
+
+// How many chains the scalar reference steps to estimate its rate.
+#define SCALAR_SAMPLE 2000
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void initialChain(size_t n, size_t chain, size_t count, float* thetas, float* omegas) {
+  for (size_t i = 0; i < n; i++) {
+    thetas[i] = BASE_THETA + PERTURBATION * chain / count;
+    omegas[i] = BASE_OMEGA;
+  }
+}
+
+// usage: bench_ensemble [links] [chains] [steps]
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LINKS;
+  size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_CHAINS;
+  long steps = argc > 3 ? strtol(argv[3], NULL, 10) : DEFAULT_STEPS;
+
+  float* thetas = (float*)malloc(n * sizeof(float));
+  float* omegas = (float*)malloc(n * sizeof(float));
+
+  struct Ensemble* ensemble = createEnsemble(n, count);
+  for (size_t c = 0; c < count; c++) {
+    initialChain(n, c, count, thetas, omegas);
+    setEnsembleChain(ensemble, c, thetas, omegas);
+  }
+
+  double start = now();
+  for (long s = 0; s < steps; s++) {
+    stepEnsemble(ensemble, TIME_STEP);
+  }
+  double ensembleSeconds = now() - start;
+
+  // Scalar rk4() over a sample of the same chains, for both the rate and
+  // a check that the lanes track the reference integrator.
+  size_t sample = count < SCALAR_SAMPLE ? count : SCALAR_SAMPLE;
+  struct Workspace* ws = createWorkspace(n, ENGINE_CHOLESKY);
+  float* laneThetas = (float*)malloc(n * sizeof(float));
+  float* laneOmegas = (float*)malloc(n * sizeof(float));
+  double worst = 0;
+  double scalarSeconds = 0;
+
+  for (size_t c = 0; c < sample; c++) {
+    initialChain(n, c, count, thetas, omegas);
+
+    start = now();
+    for (long s = 0; s < steps; s++) {
+      rk4(ws, TIME_STEP, thetas, omegas);
+    }
+    scalarSeconds += now() - start;
+
+    getEnsembleChain(ensemble, c, laneThetas, laneOmegas);
+    for (size_t i = 0; i < n; i++) {
+      worst = fmax(worst, fabs(thetas[i] - laneThetas[i]));
+    }
+  }
+
+  double ensembleRate = count * steps / ensembleSeconds;
+  double scalarRate = sample * steps / scalarSeconds;
+
+  printf("links %zu, chains %zu, steps %ld, %s x%d lanes\n", n, count, steps, ensembleInstructionSet(), ENSEMBLE_LANES);
+  printf("ensemble: %.3g chain-steps/s\n", ensembleRate);
+  printf("scalar:   %.3g chain-steps/s\n", scalarRate);
+  printf("speedup:  %.2fx\n", ensembleRate / scalarRate);
+  printf("max |theta - rk4 theta| over %zu chains: %.3g\n", sample, worst);
+
+  free(laneOmegas);
+  free(laneThetas);
+  destroyWorkspace(ws);
+  destroyEnsemble(ensemble);
+  free(omegas);
+  free(thetas);
+
+  return 0;
+}
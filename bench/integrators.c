@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "integrators.h"
+#include "physics.h"
+
+#define DEFAULT_LINKS 4
+#define DEFAULT_SECONDS 10.0f
+#define DEFAULT_INTERVAL 0.1f
+
+#define BASE_THETA 2.35619449f
+#define BASE_OMEGA 0.9f
+
+#define REFERENCE_SUBSTEPS 200
+#define DOPRI_LEVELS 6
+
+// Long-horizon energy comparison: the symplectic methods take one large
+// step, rk4 is refined until its energy drift is as small.
+#define ENERGY_SECONDS 2000.0f
+#define ENERGY_STEP 0.1f
+#define ENERGY_RK4_LEVELS 6
+
+// rk4 substeps per output interval, coarse to fine.
+static const int rk4Substeps[] = {1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128};
+#define RK4_LEVELS (int)(sizeof(rk4Substeps) / sizeof(rk4Substeps[0]))
+
+struct Run {
+  long evaluations;
+  double error;
+};
+
+static void initialState(size_t n, float* thetas, float* omegas) {
+  for (size_t i = 0; i < n; i++) {
+    thetas[i] = BASE_THETA;
+    omegas[i] = BASE_OMEGA;
+  }
+}
+
+static double stateError(size_t n, const float* thetas, const float* omegas, const float* refThetas, const float* refOmegas) {
+  double worst = 0;
+  for (size_t i = 0; i < n; i++) {
+    worst = fmax(worst, fabs(thetas[i] - refThetas[i]));
+    worst = fmax(worst, fabs(omegas[i] - refOmegas[i]));
+  }
+  return worst;
+}
+
+// Every integrator is asked for the state once per output interval, as a
+// caller sampling the trajectory would; the fixed-step methods are refined
+// by substepping each interval, dopri45 picks its own steps inside it. The
+// state is float, so errors bottom out at float rounding whatever the step
+// size.
+static struct Run runFixed(size_t n, enum Method method, long frames, float interval, int substeps, const float* refThetas, const float* refOmegas) {
+  struct Workspace* ws = createWorkspace(n, ENGINE_CHOLESKY);
+  struct Integrator* integrator = createIntegrator(ws, method);
+  float* thetas = (float*)malloc(n * sizeof(float));
+  float* omegas = (float*)malloc(n * sizeof(float));
+  initialState(n, thetas, omegas);
+
+  for (long frame = 0; frame < frames; frame++) {
+    for (int s = 0; s < substeps; s++) {
+      integrate(integrator, interval / substeps, thetas, omegas);
+    }
+  }
+
+  struct Run run = {ws->evaluations, stateError(n, thetas, omegas, refThetas, refOmegas)};
+
+  free(omegas);
+  free(thetas);
+  destroyIntegrator(integrator);
+  destroyWorkspace(ws);
+  return run;
+}
+
+// Cheapest rk4 setting that is at least as accurate, or -1.
+static long matchRk4(const struct Run* rk4Runs, double error) {
+  for (int r = 0; r < RK4_LEVELS; r++) {
+    if (rk4Runs[r].error <= error) {
+      return rk4Runs[r].evaluations;
+    }
+  }
+  return -1;
+}
+
+static void printSavings(const char* label, struct Run run, long match) {
+  if (match > 0) {
+    printf("%-22s %12ld %12.3g %12ld (%5.1f%%)\n", label, run.evaluations, run.error, match - run.evaluations,
+           100.0 * (match - run.evaluations) / match);
+  } else {
+    printf("%-22s %12ld %12.3g %26s\n", label, run.evaluations, run.error, "no rk4 run as accurate");
+  }
+}
+
+// Double-precision reference: the same equations of motion assembled
+// directly and solved by Gaussian elimination, stepped with a fine rk4. The
+// float pipeline cannot serve as its own reference, since taking many tiny
+// float steps adds rounding error faster than it removes truncation error.
+static void referenceDerivative(size_t n, const double* thetas, const double* omegas, double* M, double* alphas) {
+  for (size_t i = 0; i < n; i++) {
+    double b = 0;
+    for (size_t j = 0; j < n; j++) {
+      double weight = (double)(n - (i > j ? i : j));
+      M[i * n + j] = weight * cos(thetas[i] - thetas[j]);
+      b -= weight * omegas[j] * omegas[j] * sin(thetas[i] - thetas[j]);
+    }
+    alphas[i] = b - (double)(n - i) * GRAVITY * sin(thetas[i]);
+  }
+
+  // M is symmetric positive definite, so elimination without pivoting is
+  // stable.
+  for (size_t k = 0; k < n; k++) {
+    for (size_t i = k + 1; i < n; i++) {
+      double factor = M[i * n + k] / M[k * n + k];
+      for (size_t j = k; j < n; j++) {
+        M[i * n + j] -= factor * M[k * n + j];
+      }
+      alphas[i] -= factor * alphas[k];
+    }
+  }
+
+  for (size_t i = n; i-- > 0;) {
+    for (size_t j = i + 1; j < n; j++) {
+      alphas[i] -= M[i * n + j] * alphas[j];
+    }
+    alphas[i] /= M[i * n + i];
+  }
+}
+
+static void referenceState(size_t n, long frames, float interval, float* thetas, float* omegas) {
+  double* y = (double*)malloc(2 * n * sizeof(double));
+  double* stage = (double*)malloc(2 * n * sizeof(double));
+  double* k = (double*)malloc(4 * 2 * n * sizeof(double));
+  double* M = (double*)malloc(n * n * sizeof(double));
+
+  for (size_t i = 0; i < n; i++) {
+    y[i] = BASE_THETA;
+    y[n + i] = BASE_OMEGA;
+  }
+
+  static const double stageScale[4] = {0.0, 0.5, 0.5, 1.0};
+  double h = (double)interval / REFERENCE_SUBSTEPS;
+
+  for (long step = 0; step < frames * REFERENCE_SUBSTEPS; step++) {
+    for (int s = 0; s < 4; s++) {
+      double* ks = k + s * 2 * n;
+      for (size_t i = 0; i < 2 * n; i++) {
+        stage[i] = y[i] + (s > 0 ? stageScale[s] * h * k[(s - 1) * 2 * n + i] : 0.0);
+      }
+      memcpy(ks, stage + n, n * sizeof(double));
+      referenceDerivative(n, stage, stage + n, M, ks + n);
+    }
+
+    for (size_t i = 0; i < 2 * n; i++) {
+      y[i] += h / 6.0 * (k[i] + 2.0 * k[2 * n + i] + 2.0 * k[4 * n + i] + k[6 * n + i]);
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    thetas[i] = (float)y[i];
+    omegas[i] = (float)y[n + i];
+  }
+
+  free(M);
+  free(k);
+  free(stage);
+  free(y);
+}
+
+static struct Run runDopri(size_t n, long frames, float interval, float tolerance, const float* refThetas, const float* refOmegas, long* rejected) {
+  struct Workspace* ws = createWorkspace(n, ENGINE_CHOLESKY);
+  struct Integrator* integrator = createIntegrator(ws, METHOD_DOPRI45);
+  integrator->rtol = tolerance;
+  integrator->atol = tolerance;
+
+  float* thetas = (float*)malloc(n * sizeof(float));
+  float* omegas = (float*)malloc(n * sizeof(float));
+  initialState(n, thetas, omegas);
+
+  for (long frame = 0; frame < frames; frame++) {
+    integrate(integrator, interval, thetas, omegas);
+  }
+
+  struct Run run = {ws->evaluations, stateError(n, thetas, omegas, refThetas, refOmegas)};
+  *rejected = integrator->rejected;
+
+  free(omegas);
+  free(thetas);
+  destroyIntegrator(integrator);
+  destroyWorkspace(ws);
+  return run;
+}
+
+// Largest |E(t) - E(0)| seen over the run, sampled every step.
+static struct Run runEnergy(size_t n, enum Method method, float dt, float seconds) {
+  struct Workspace* ws = createWorkspace(n, ENGINE_CHOLESKY);
+  struct Integrator* integrator = createIntegrator(ws, method);
+
+  float* thetas = (float*)malloc(n * sizeof(float));
+  float* omegas = (float*)malloc(n * sizeof(float));
+  initialState(n, thetas, omegas);
+
+  double initial = energy(n, thetas, omegas);
+  double worst = 0;
+  long steps = (long)(seconds / dt);
+
+  for (long step = 0; step < steps; step++) {
+    integrate(integrator, dt, thetas, omegas);
+    worst = fmax(worst, fabs(energy(n, thetas, omegas) - initial));
+  }
+
+  struct Run run = {ws->evaluations, worst};
+
+  free(omegas);
+  free(thetas);
+  destroyIntegrator(integrator);
+  destroyWorkspace(ws);
+  return run;
+}
+
+// usage: bench_integrators [links] [seconds] [output interval]
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LINKS;
+  float seconds = argc > 2 ? strtof(argv[2], NULL) : DEFAULT_SECONDS;
+  float interval = argc > 3 ? strtof(argv[3], NULL) : DEFAULT_INTERVAL;
+  long frames = (long)(seconds / interval);
+
+  float* refThetas = (float*)malloc(n * sizeof(float));
+  float* refOmegas = (float*)malloc(n * sizeof(float));
+
+  referenceState(n, frames, interval, refThetas, refOmegas);
+
+  printf("links %zu, %.2f s simulated in %ld intervals of %.4f s\n", n, seconds, frames, interval);
+
+  struct Run rk4Runs[RK4_LEVELS];
+  printf("\n%-22s %12s %12s\n", "rk4", "f() calls", "max error");
+  for (int level = 0; level < RK4_LEVELS; level++) {
+    int substeps = rk4Substeps[level];
+    rk4Runs[level] = runFixed(n, METHOD_RK4, frames, interval, substeps, refThetas, refOmegas);
+
+    char label[32];
+    snprintf(label, sizeof(label), "dt = %.5f", interval / substeps);
+    printf("%-22s %12ld %12.3g\n", label, rk4Runs[level].evaluations, rk4Runs[level].error);
+  }
+
+  // abm4 spends 2 f() calls per step against rk4's 4, plus an rk4 start-up.
+  printf("\n%-22s %12s %12s %26s\n", "abm4", "f() calls", "max error", "f() calls saved vs rk4");
+  for (int level = 0; level < RK4_LEVELS; level++) {
+    int substeps = rk4Substeps[level];
+    struct Run run = runFixed(n, METHOD_ABM4, frames, interval, substeps, refThetas, refOmegas);
+
+    char label[32];
+    snprintf(label, sizeof(label), "dt = %.5f", interval / substeps);
+    printSavings(label, run, matchRk4(rk4Runs, run.error));
+  }
+
+  printf("\n%-22s %12s %12s %10s %26s\n", "dopri45", "f() calls", "max error", "rejected", "f() calls saved vs rk4");
+  for (int level = 0; level < DOPRI_LEVELS; level++) {
+    float tolerance = powf(10.0f, -1.0f - level);
+    long rejected = 0;
+    struct Run run = runDopri(n, frames, interval, tolerance, refThetas, refOmegas, &rejected);
+
+    long match = matchRk4(rk4Runs, run.error);
+
+    char label[32];
+    snprintf(label, sizeof(label), "tol = %.0e", tolerance);
+    if (match > 0) {
+      printf("%-22s %12ld %12.3g %10ld %12ld (%5.1f%%)\n", label, run.evaluations, run.error, rejected,
+             match - run.evaluations, 100.0 * (match - run.evaluations) / match);
+    } else {
+      printf("%-22s %12ld %12.3g %10ld %26s\n", label, run.evaluations, run.error, rejected, "no rk4 run as accurate");
+    }
+  }
+
+  printf("\nenergy over %.0f s, max |E - E0|\n", ENERGY_SECONDS);
+  printf("%-22s %12s %12s\n", "method", "f() calls", "max dE");
+
+  struct Run rk4Energy[ENERGY_RK4_LEVELS];
+  for (int level = 0; level < ENERGY_RK4_LEVELS; level++) {
+    float dt = ENERGY_STEP / (1 << level);
+    rk4Energy[level] = runEnergy(n, METHOD_RK4, dt, ENERGY_SECONDS);
+
+    char label[32];
+    snprintf(label, sizeof(label), "rk4 dt = %.5f", dt);
+    printf("%-22s %12ld %12.3g\n", label, rk4Energy[level].evaluations, rk4Energy[level].error);
+  }
+
+  enum Method symplectic[2] = {METHOD_GAUSS2, METHOD_GAUSS3};
+  const char* names[2] = {"gauss2", "gauss3"};
+  for (int m = 0; m < 2; m++) {
+    struct Run run = runEnergy(n, symplectic[m], ENERGY_STEP, ENERGY_SECONDS);
+
+    char label[32];
+    snprintf(label, sizeof(label), "%s dt = %.5f", names[m], ENERGY_STEP);
+    printf("%-22s %12ld %12.3g", label, run.evaluations, run.error);
+
+    long match = -1;
+    for (int r = 0; r < ENERGY_RK4_LEVELS; r++) {
+      if (rk4Energy[r].error <= run.error) {
+        match = rk4Energy[r].evaluations;
+        break;
+      }
+    }
+
+    if (match > 0) {
+      printf("   rk4 needs %ld (%.1fx)\n", match, (double)match / run.evaluations);
+    } else {
+      printf("   no rk4 run as good\n");
+    }
+  }
+
+  free(refOmegas);
+  free(refThetas);
+  return 0;
+}
@@ -0,0 +1,285 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "alloccount.h"
+#include "physics.h"
+
+#define MIN_N 2
+#define DEFAULT_MAX_N 512
+
+#define WARMUP_SECONDS 0.02
+#define SAMPLE_SECONDS 20e-6
+#define KERNEL_SECONDS 0.25
+#define MIN_SAMPLES 11
+#define MAX_SAMPLES 201
+
+#define TIME_STEP 1e-4f
+
+struct Context {
+  size_t n;
+  struct Workspace* lu;
+  struct Workspace* cholesky;
+  struct Workspace* aba;
+
+  float* thetas;
+  float* omegas;
+  float* A;
+  float* B;
+  float* L;
+  float* U;
+  float* y;
+  float* x;
+  float* LD;
+  float* dThetas;
+  float* dOmegas;
+  float* stepThetas;
+  float* stepOmegas;
+};
+
+static void runCreateMatrixA(struct Context* c) { createMatrixA(c->n, c->thetas, c->A); }
+static void runCreateVectorB(struct Context* c) { createVectorB(c->n, c->thetas, c->omegas, c->B); }
+static void runAssembleSystem(struct Context* c) { assembleSystem(c->cholesky, c->thetas, c->omegas); }
+static void runLuDecompose(struct Context* c) { lu_decompose(c->n, c->A, c->L, c->U); }
+static void runForwardSubstitution(struct Context* c) { forward_substitution(c->n, c->L, c->B, c->y); }
+static void runBackwardSubstitution(struct Context* c) { backward_substitution(c->n, c->U, c->y, c->x); }
+
+// The factorisation is in place, so each call starts from a fresh copy of
+// A; the O(n^2) copy is noise next to the O(n^3) factorisation.
+static void runLdltDecompose(struct Context* c) {
+  memcpy(c->LD, c->A, c->n * c->n * sizeof(float));
+  ldlt_decompose(c->n, c->LD);
+}
+
+static void runLdltSubstitution(struct Context* c) {
+  memcpy(c->x, c->B, c->n * sizeof(float));
+  ldlt_substitution(c->n, c->LD, c->x);
+}
+
+static void runFLU(struct Context* c) { f(c->lu, c->thetas, c->omegas, c->dThetas, c->dOmegas); }
+static void runFCholesky(struct Context* c) { f(c->cholesky, c->thetas, c->omegas, c->dThetas, c->dOmegas); }
+static void runFABA(struct Context* c) { f(c->aba, c->thetas, c->omegas, c->dThetas, c->dOmegas); }
+
+// rk4 always steps from the same state, so long runs cannot wander into a
+// different (or non-finite) part of the trajectory.
+static void runRk4(struct Context* c) {
+  memcpy(c->stepThetas, c->thetas, c->n * sizeof(float));
+  memcpy(c->stepOmegas, c->omegas, c->n * sizeof(float));
+  rk4(c->lu, TIME_STEP, c->stepThetas, c->stepOmegas);
+}
+
+// Nominal flop counts. A sin, cos or divide counts as one flop, and
+// fmax() and the integer-to-float conversions are not counted.
+static double flopsCreateMatrixA(double n) { return 4 * n * n; }
+static double flopsCreateVectorB(double n) { return 7 * n * n + 5 * n; }
+static double flopsAssembleSystem(double n) { return 8 * n * n + 12 * n; }
+static double flopsLuDecompose(double n) { return 2 * n * n * n / 3; }
+static double flopsForwardSubstitution(double n) { return n * n; }
+static double flopsBackwardSubstitution(double n) { return n * n + n; }
+static double flopsLdltDecompose(double n) { return n * n * n / 3 + 2 * n * n; }
+static double flopsLdltSubstitution(double n) { return 2 * n * n + n; }
+static double flopsFLU(double n) { return flopsAssembleSystem(n) + flopsLuDecompose(n) + 2 * n * n + n; }
+static double flopsFCholesky(double n) { return flopsAssembleSystem(n) + flopsLdltDecompose(n) + flopsLdltSubstitution(n); }
+static double flopsFABA(double n) { return 110 * n; }
+static double flopsRk4(double n) { return 4 * flopsFLU(n) + 22 * n; }
+
+struct Kernel {
+  const char* name;
+  void (*run)(struct Context* context);
+  double (*flops)(double n);
+};
+
+static const struct Kernel kernels[] = {
+  {"createMatrixA", runCreateMatrixA, flopsCreateMatrixA},
+  {"createVectorB", runCreateVectorB, flopsCreateVectorB},
+  {"assembleSystem", runAssembleSystem, flopsAssembleSystem},
+  {"lu_decompose", runLuDecompose, flopsLuDecompose},
+  {"forward_substitution", runForwardSubstitution, flopsForwardSubstitution},
+  {"backward_substitution", runBackwardSubstitution, flopsBackwardSubstitution},
+  {"ldlt_decompose", runLdltDecompose, flopsLdltDecompose},
+  {"ldlt_substitution", runLdltSubstitution, flopsLdltSubstitution},
+  {"f (lu)", runFLU, flopsFLU},
+  {"f (cholesky)", runFCholesky, flopsFCholesky},
+  {"f (aba)", runFABA, flopsFABA},
+  {"rk4 (lu)", runRk4, flopsRk4},
+};
+
+#define KERNEL_COUNT (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+struct Result {
+  double median;
+  double p99;
+  double gflops;
+  double bytes;
+  int samples;
+  long batch;
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compareDoubles(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+// Warms up for WARMUP_SECONDS, sizes a batch of calls to cover at least
+// SAMPLE_SECONDS so the clock's resolution does not matter, then takes as
+// many batch samples as fit in KERNEL_SECONDS (within MIN_SAMPLES and
+// MAX_SAMPLES). Times are per call. With few samples p99 is simply the
+// slowest one.
+static struct Result measure(const struct Kernel* kernel, struct Context* context, double* samples) {
+  struct Result result;
+
+  long calls = 0;
+  double start = now();
+  double elapsed;
+  do {
+    kernel->run(context);
+    calls++;
+    elapsed = now() - start;
+  } while (elapsed < WARMUP_SECONDS);
+
+  double perCall = elapsed / calls;
+  long batch = (long)ceil(SAMPLE_SECONDS / perCall);
+  int count = (int)(KERNEL_SECONDS / (perCall * batch));
+  count = count < MIN_SAMPLES ? MIN_SAMPLES : count > MAX_SAMPLES ? MAX_SAMPLES : count;
+
+  size_t allocatedBefore = allocatedBytes();
+
+  for (int s = 0; s < count; s++) {
+    double sampleStart = now();
+    for (long b = 0; b < batch; b++) {
+      kernel->run(context);
+    }
+    samples[s] = (now() - sampleStart) / batch;
+  }
+
+  result.bytes = (double)(allocatedBytes() - allocatedBefore) / ((double)count * batch);
+
+  qsort(samples, count, sizeof(double), compareDoubles);
+  result.median = samples[count / 2];
+  result.p99 = samples[(int)ceil(0.99 * count) - 1];
+  result.gflops = kernel->flops((double)context->n) / result.median * 1e-9;
+  result.samples = count;
+  result.batch = batch;
+  return result;
+}
+
+static void createContext(struct Context* c, size_t n) {
+  c->n = n;
+  c->lu = createWorkspace(n, ENGINE_LU);
+  c->cholesky = createWorkspace(n, ENGINE_CHOLESKY);
+  c->aba = createWorkspace(n, ENGINE_ABA);
+
+  c->thetas = (float*)malloc(n * sizeof(float));
+  c->omegas = (float*)malloc(n * sizeof(float));
+  c->A = (float*)malloc(n * n * sizeof(float));
+  c->B = (float*)malloc(n * sizeof(float));
+  c->L = (float*)malloc(n * n * sizeof(float));
+  c->U = (float*)malloc(n * n * sizeof(float));
+  c->y = (float*)malloc(n * sizeof(float));
+  c->x = (float*)malloc(n * sizeof(float));
+  c->LD = (float*)malloc(n * n * sizeof(float));
+  c->dThetas = (float*)malloc(n * sizeof(float));
+  c->dOmegas = (float*)malloc(n * sizeof(float));
+  c->stepThetas = (float*)malloc(n * sizeof(float));
+  c->stepOmegas = (float*)malloc(n * sizeof(float));
+
+  srand((unsigned)n);
+  for (size_t i = 0; i < n; i++) {
+    c->thetas[i] = 6.2831853f * rand() / RAND_MAX;
+    c->omegas[i] = 4.0f * rand() / RAND_MAX - 2.0f;
+  }
+
+  createMatrixA(n, c->thetas, c->A);
+  createVectorB(n, c->thetas, c->omegas, c->B);
+  lu_decompose(n, c->A, c->L, c->U);
+  forward_substitution(n, c->L, c->B, c->y);
+  memcpy(c->LD, c->A, n * n * sizeof(float));
+  ldlt_decompose(n, c->LD);
+}
+
+static void destroyContext(struct Context* c) {
+  free(c->stepOmegas);
+  free(c->stepThetas);
+  free(c->dOmegas);
+  free(c->dThetas);
+  free(c->LD);
+  free(c->x);
+  free(c->y);
+  free(c->U);
+  free(c->L);
+  free(c->B);
+  free(c->A);
+  free(c->omegas);
+  free(c->thetas);
+
+  destroyWorkspace(c->aba);
+  destroyWorkspace(c->cholesky);
+  destroyWorkspace(c->lu);
+}
+
+// usage: bench_kernels [max links] [json file]
+int main(int argc, char** argv) {
+  size_t maxN = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_MAX_N;
+  const char* jsonPath = argc > 2 ? argv[2] : NULL;
+
+  FILE* json = NULL;
+  if (jsonPath != NULL) {
+    json = fopen(jsonPath, "w");
+    if (json == NULL) {
+      printf("Failed to open %s\n", jsonPath);
+      return 1;
+    }
+    fprintf(json, "{\n  \"allocation_tracking\": %s,\n  \"results\": [", ALLOCATION_TRACKING ? "true" : "false");
+  }
+
+  double samples[MAX_SAMPLES];
+  int first = 1;
+
+  printf("%-22s %6s %14s %14s %10s %12s %8s\n", "kernel", "n", "median ns", "p99 ns", "GFLOP/s", "bytes/call", "samples");
+
+  for (size_t n = MIN_N; n <= maxN; n *= 2) {
+    struct Context context;
+    createContext(&context, n);
+
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+      struct Result result = measure(&kernels[k], &context, samples);
+
+      char bytes[32];
+      if (ALLOCATION_TRACKING) {
+        snprintf(bytes, sizeof(bytes), "%.0f", result.bytes);
+      } else {
+        snprintf(bytes, sizeof(bytes), "n/a");
+      }
+
+      printf("%-22s %6zu %14.1f %14.1f %10.3f %12s %8d\n", kernels[k].name, n, result.median * 1e9, result.p99 * 1e9,
+             result.gflops, bytes, result.samples);
+
+      if (json != NULL) {
+        fprintf(json, "%s\n    {\"kernel\": \"%s\", \"n\": %zu, \"median_ns\": %.1f, \"p99_ns\": %.1f, \"gflops\": %.4f, "
+                      "\"bytes_per_call\": %s, \"samples\": %d, \"batch\": %ld}",
+                first ? "" : ",", kernels[k].name, n, result.median * 1e9, result.p99 * 1e9, result.gflops,
+                ALLOCATION_TRACKING ? bytes : "null", result.samples, result.batch);
+        first = 0;
+      }
+    }
+
+    destroyContext(&context);
+  }
+
+  if (json != NULL) {
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+  }
+
+  return 0;
+}
@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ensemble.h"
+#include "physics.h"
+#include "threadpool.h"
+
+#define DEFAULT_LINKS 2
+#define DEFAULT_CHAINS 200000
+#define DEFAULT_STEPS 100
+
+#define TIME_STEP 0.0166f
+#define BASE_THETA 2.35619449f
+#define BASE_OMEGA 0.9f
+#define PERTURBATION 1e-4f
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// FNV-1a over the raw state, so any bitwise difference shows up.
+static uint64_t stateHash(const struct Ensemble* ensemble) {
+  size_t bytes = ensemble->blocks * ensemble->n * ENSEMBLE_LANES * sizeof(float);
+  const unsigned char* arrays[2] = {(const unsigned char*)ensemble->thetas, (const unsigned char*)ensemble->omegas};
+  uint64_t hash = 14695981039346656037ull;
+
+  for (int a = 0; a < 2; a++) {
+    for (size_t i = 0; i < bytes; i++) {
+      hash = (hash ^ arrays[a][i]) * 1099511628211ull;
+    }
+  }
+
+  return hash;
+}
+
+static struct Ensemble* initialEnsemble(size_t n, size_t count) {
+  struct Ensemble* ensemble = createEnsemble(n, count);
+  float* thetas = (float*)malloc(n * sizeof(float));
+  float* omegas = (float*)malloc(n * sizeof(float));
+
+  for (size_t c = 0; c < count; c++) {
+    for (size_t i = 0; i < n; i++) {
+      thetas[i] = BASE_THETA + PERTURBATION * c / count;
+      omegas[i] = BASE_OMEGA;
+    }
+    setEnsembleChain(ensemble, c, thetas, omegas);
+  }
+
+  free(omegas);
+  free(thetas);
+  return ensemble;
+}
+
+// usage: bench_parallel [links] [chains] [steps] [max threads]
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LINKS;
+  size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_CHAINS;
+  long steps = argc > 3 ? strtol(argv[3], NULL, 10) : DEFAULT_STEPS;
+  int maxThreads = argc > 4 ? atoi(argv[4]) : hardwareThreads();
+
+  printf("links %zu, chains %zu, steps %ld, %s x%d lanes\n", n, count, steps, ensembleInstructionSet(), ENSEMBLE_LANES);
+  printf("%8s %16s %9s %18s %24s %24s\n", "threads", "chain-steps/s", "speedup", "state hash", "energy (deterministic)", "energy (per-worker)");
+
+  double baseline = 0;
+
+  for (int threads = 1;; threads *= 2) {
+    if (threads > maxThreads) {
+      threads = maxThreads;
+    }
+
+    struct ThreadPool* pool = createThreadPool(threads, 1);
+    struct ThreadPool* fastPool = createThreadPool(threads, 0);
+    struct Ensemble* ensemble = initialEnsemble(n, count);
+
+    double start = now();
+    stepEnsembleParallel(ensemble, pool, TIME_STEP, steps);
+    double rate = count * steps / (now() - start);
+
+    if (threads == 1) {
+      baseline = rate;
+    }
+
+    printf("%8d %16.3g %8.2fx %18llx %24.17g %24.17g\n", threads, rate, rate / baseline,
+           (unsigned long long)stateHash(ensemble), ensembleEnergy(ensemble, pool), ensembleEnergy(ensemble, fastPool));
+
+    destroyEnsemble(ensemble);
+    destroyThreadPool(fastPool);
+    destroyThreadPool(pool);
+
+    if (threads == maxThreads) {
+      break;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,95 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "physics.h"
+
+#define MIN_N 2
+#define MAX_N 512
+
+// Roughly how many flops each measurement should cover, so small n gets
+// enough repetitions to rise above timer resolution.
+#define FLOP_BUDGET 2e8
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double residual(size_t n, const float* A, const float* B, const float* x) {
+  double worst = 0;
+  for (size_t i = 0; i < n; i++) {
+    double r = -B[i];
+    for (size_t j = 0; j < n; j++) {
+      r += (double)A[i * n + j] * x[j];
+    }
+    worst = fmax(worst, fabs(r));
+  }
+  return worst;
+}
+
+// Both solvers are timed from a fresh copy of A, as they would see it
+// straight out of createMatrixA() inside f(). The copy costs the same on
+// both sides and keeps the in-place LDL^T honest.
+int main(void) {
+  printf("%6s %14s %14s %8s %12s %12s\n", "n", "lu ns/solve", "ldlt ns/solve", "speedup", "lu resid", "ldlt resid");
+
+  for (size_t n = MIN_N; n <= MAX_N; n *= 2) {
+    struct Workspace* lu = createWorkspace(n, ENGINE_LU);
+    struct Workspace* ldlt = createWorkspace(n, ENGINE_CHOLESKY);
+
+    float* thetas = (float*)malloc(n * sizeof(float));
+    float* omegas = (float*)malloc(n * sizeof(float));
+    float* A = (float*)malloc(n * n * sizeof(float));
+    float* B = (float*)malloc(n * sizeof(float));
+    float* xLU = (float*)malloc(n * sizeof(float));
+    float* xLDLT = (float*)malloc(n * sizeof(float));
+
+    srand((unsigned)n);
+    for (size_t i = 0; i < n; i++) {
+      thetas[i] = 6.2831853f * rand() / RAND_MAX;
+      omegas[i] = 4.0f * rand() / RAND_MAX - 2.0f;
+    }
+    createMatrixA(n, thetas, A);
+    createVectorB(n, thetas, omegas, B);
+
+    long reps = (long)(FLOP_BUDGET / ((double)n * n * n + 1e3));
+    if (reps < 3) {
+      reps = 3;
+    }
+
+    double start = now();
+    for (long r = 0; r < reps; r++) {
+      memcpy(lu->A, A, n * n * sizeof(float));
+      solveLinearSystem(lu, lu->A, B, xLU);
+    }
+    double luSeconds = (now() - start) / reps;
+
+    start = now();
+    for (long r = 0; r < reps; r++) {
+      memcpy(ldlt->A, A, n * n * sizeof(float));
+      solveSymmetricSystem(ldlt, ldlt->A, B, xLDLT);
+    }
+    double ldltSeconds = (now() - start) / reps;
+
+    printf("%6zu %14.0f %14.0f %7.2fx %12.3g %12.3g\n", n, luSeconds * 1e9, ldltSeconds * 1e9,
+           luSeconds / ldltSeconds, residual(n, A, B, xLU), residual(n, A, B, xLDLT));
+
+    free(xLDLT);
+    free(xLU);
+    free(B);
+    free(A);
+    free(omegas);
+    free(thetas);
+
+    destroyWorkspace(ldlt);
+    destroyWorkspace(lu);
+  }
+
+  return 0;
+}
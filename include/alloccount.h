@@ -0,0 +1,20 @@
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+
+#include <stddef.h>
+
+// Linking src/alloccount.c into a harness counts every malloc, calloc and
+// realloc in the process, so a kernel that allocates in its hot path shows
+// up as a nonzero count. Needs glibc, whose allocator entry points can be
+// called underneath an override; elsewhere the counters stay at zero and
+// ALLOCATION_TRACKING is 0.
+#ifdef __GLIBC__
+#define ALLOCATION_TRACKING 1
+#else
+#define ALLOCATION_TRACKING 0
+#endif
+
+size_t allocationCount(void);
+size_t allocatedBytes(void);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef BLOCKED_H
+#define BLOCKED_H
+
+#include <stddef.h>
+
+// Blocked, right-looking LDL^T for long dense chains. Each step factors a
+// BLOCKED_PANEL-wide diagonal block, solves the panel of rows below it and
+// applies the rank-BLOCKED_PANEL update to the trailing triangle in
+// BLOCKED_TILE-column tiles. The update kernel streams each tile's slice
+// of the panel from cache with SIMD multiply-adds along contiguous rows.
+// The result is stored exactly as ldlt_decompose() stores it, so
+// ldlt_substitution() solves against it unchanged.
+//
+// Build with -march=native (or -mavx2) for the wide vector paths.
+#define BLOCKED_PANEL 64
+#define BLOCKED_TILE 256
+
+// Below this size the unblocked ldlt_decompose() is as fast.
+#define BLOCKED_MIN_N 256
+
+struct ThreadPool;
+
+// scratch holds BLOCKED_PANEL * n floats. With a pool, panel rows and
+// trailing tiles are spread across its workers; pass NULL to run on the
+// calling thread.
+void blocked_ldlt_decompose(size_t n, float* A, float* scratch, struct ThreadPool* pool);
+
+#endif
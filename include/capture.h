@@ -0,0 +1,71 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <glad/glad.h>
+
+// Pixel buffers in the readback ring. A frame's pixels are collected when
+// its buffer comes round again, CAPTURE_PBOS - 1 frames after the read was
+// issued, by which time the GPU has long finished it.
+#define CAPTURE_PBOS 3
+
+// Frames held for the writer thread. When it falls this far behind, the
+// render thread waits rather than dropping frames from the recording.
+#define CAPTURE_QUEUE 8
+
+// Records frames drawn into an offscreen framebuffer. glReadPixels goes
+// into a pixel buffer object, so it returns at once; the pixels are copied
+// out on a later frame and handed to a writer thread that converts and
+// writes them. A path ending in ".y4m" gives one raw 4:4:4 Y4M stream;
+// anything else is a printf pattern for one PPM per frame, such as
+// "frame%05d.ppm".
+struct Capture {
+  int width;
+  int height;
+  int y4m;
+  const char* path;
+  FILE* file;
+
+  GLuint framebuffer;
+  GLuint colorBuffer;
+
+  GLuint pbos[CAPTURE_PBOS];
+  GLsync fences[CAPTURE_PBOS];
+  int next;
+
+  // Frames [written, queued) are waiting in queue, the oldest at
+  // written % CAPTURE_QUEUE.
+  unsigned char* queue[CAPTURE_QUEUE];
+  unsigned long queued;
+  unsigned long written;
+  int stopping;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  pthread_cond_t space;
+  pthread_t thread;
+
+  // Render-thread time spent in endCapture() and the parts of it spent
+  // waiting on fences or on the writer.
+  unsigned long frames;
+  double seconds;
+  double fenceSeconds;
+  double stallSeconds;
+};
+
+// Returns NULL and prints why if the output cannot be opened. fps only
+// goes into the Y4M header.
+struct Capture* createCapture(int width, int height, int fps, const char* path);
+// Writes every frame still in flight before returning.
+void destroyCapture(struct Capture* capture);
+
+// Binds the offscreen framebuffer and sets the viewport to it; draw the
+// frame, then call endCapture().
+void beginCapture(struct Capture* capture);
+void endCapture(struct Capture* capture);
+
+// Copies the last captured frame to the default framebuffer, scaled to
+// width x height.
+void presentCapture(const struct Capture* capture, int width, int height);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <stddef.h>
+
+// Chains are stepped ENSEMBLE_LANES at a time, one chain per SIMD lane.
+// The width follows the instruction set the translation unit is compiled
+// for (build with -march=native or -mavx2 to get the wide paths); define
+// ENSEMBLE_SCALAR, or use a compiler without GNU vector extensions, to get
+// the one-lane fallback.
+#if defined(__GNUC__) && !defined(ENSEMBLE_SCALAR)
+#if defined(__AVX512F__)
+#define ENSEMBLE_LANES 16
+#elif defined(__AVX__)
+#define ENSEMBLE_LANES 8
+#else
+#define ENSEMBLE_LANES 4
+#endif
+#else
+#define ENSEMBLE_LANES 1
+#endif
+
+// Chains are handed to worker threads in shards of whole blocks sized so a
+// shard's state stays resident in a typical L2 while it is stepped.
+#define ENSEMBLE_SHARD_BYTES (128 * 1024)
+
+struct ThreadPool;
+
+// Per-thread scratch for stepping one block of ENSEMBLE_LANES chains. All
+// buffers hold lane vectors, so A is n * n * ENSEMBLE_LANES floats.
+struct EnsembleScratch {
+  float* A;
+  float* B;
+  float* sines;
+  float* cosines;
+  float* omegaSines;
+  float* omegaCosines;
+
+  float* stageThetas;
+  float* stageOmegas;
+
+  float* kThetas[4];
+  float* kOmegas[4];
+};
+
+// Many independent n-link chains in structure-of-arrays blocks: the state
+// of link i of chain c lives at [(c / LANES) * n + i] * LANES + c % LANES,
+// so one aligned vector load picks up the same link across a whole block.
+// Padding lanes in the last block hold a resting chain and are never
+// reported. Every chain has unit masses and lengths.
+struct Ensemble {
+  size_t n;
+  size_t count;
+  size_t blocks;
+
+  float* weights;
+  float* thetas;
+  float* omegas;
+
+  struct EnsembleScratch* scratch;
+
+  struct EnsembleScratch** workerScratch;
+  int workerScratchCount;
+};
+
+struct Ensemble* createEnsemble(size_t n, size_t count);
+void destroyEnsemble(struct Ensemble* ensemble);
+
+struct EnsembleScratch* createEnsembleScratch(size_t n);
+void destroyEnsembleScratch(struct EnsembleScratch* scratch);
+
+void setEnsembleChain(struct Ensemble* ensemble, size_t chain, const float* thetas, const float* omegas);
+void getEnsembleChain(const struct Ensemble* ensemble, size_t chain, float* thetas, float* omegas);
+
+void stepEnsembleBlocks(struct Ensemble* ensemble, struct EnsembleScratch* scratch, float dt, size_t firstBlock, size_t lastBlock);
+void stepEnsemble(struct Ensemble* ensemble, float dt);
+void stepEnsembleParallel(struct Ensemble* ensemble, struct ThreadPool* pool, float dt, long steps);
+
+double ensembleEnergy(struct Ensemble* ensemble, struct ThreadPool* pool);
+
+const char* ensembleInstructionSet(void);
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef INTEGRATORS_H
+#define INTEGRATORS_H
+
+#include <stddef.h>
+
+#include "physics.h"
+
+#define DOPRI_ATOL 1e-6f
+#define DOPRI_RTOL 1e-5f
+
+#define GAUSS_TOLERANCE 1e-6f
+#define GAUSS_MAX_ITERATIONS 50
+#define GAUSS_MAX_SPLITS 8
+
+#define ABM_STEPS 4
+
+// Time-stepping schemes layered on f(). METHOD_RK4 is the fixed-step
+// rk4() from physics.c. METHOD_DOPRI45 is the adaptive Dormand-Prince
+// RK5(4) pair: it takes as many internal steps as its tolerances require
+// to cover each requested dt. METHOD_GAUSS2 and METHOD_GAUSS3 are the
+// implicit Gauss-Legendre collocation methods of order 4 and 6, applied to
+// the chain's Hamiltonian form (theta, p = M omega). They are symplectic,
+// so energy error stays bounded over arbitrarily long runs instead of
+// drifting. They need a dense engine, since every stage solves against
+// M(theta). The stages are solved by fixed-point iteration, which at large
+// dt takes many sweeps and has to split steps. Prefer METHOD_GAUSS3:
+// gauss2 costs as much per step and is rarely worth it. On 4 links at
+// dt = 0.1 (make bench-integrators) gauss2 makes about 27 f() calls per
+// step against rk4's 4, and its energy error is still worse than rk4's at
+// the same dt. gauss3 holds energy as well as rk4 does at dt / 32, with
+// 4.6 times fewer f() calls.
+// METHOD_ABM4 is the fourth-order Adams-Bashforth-Moulton predictor-
+// corrector: it reuses the derivatives of the last ABM_STEPS steps, so each
+// step costs two f() calls instead of rk4's four.
+enum Method {
+  METHOD_RK4,
+  METHOD_DOPRI45,
+  METHOD_GAUSS2,
+  METHOD_GAUSS3,
+  METHOD_ABM4,
+};
+
+struct Integrator {
+  enum Method method;
+  struct Workspace* ws;
+
+  // Dormand-Prince state. h is the step the controller wants next and
+  // survives across calls; lastThetas/lastOmegas are the state the FSAL
+  // derivative in kThetas[6]/kOmegas[6] belongs to.
+  float atol;
+  float rtol;
+  float h;
+  float previousError;
+  int haveLast;
+  float* lastThetas;
+  float* lastOmegas;
+
+  float* kThetas[7];
+  float* kOmegas[7];
+  float* stageThetas;
+  float* stageOmegas;
+
+  long accepted;
+  long rejected;
+
+  // Gauss-Legendre state. momenta belong to lastThetas/lastOmegas. The
+  // stage derivatives (theta', p') of the previous step sit in
+  // kThetas/kOmegas[0..stages) and seed the next fixed-point solve;
+  // [3..3 + stages) hold the iterate being computed.
+  float* momenta;
+  int haveStages;
+  long iterations;
+  long splits;
+
+  // Adams-Bashforth-Moulton state. historyThetas/historyOmegas is a ring of
+  // f() at the last historyCount states, newest at historyHead, all taken
+  // historyStep apart and ending at lastThetas/lastOmegas.
+  float* historyThetas[ABM_STEPS];
+  float* historyOmegas[ABM_STEPS];
+  int historyHead;
+  int historyCount;
+  float historyStep;
+  long restarts;
+};
+
+struct Integrator* createIntegrator(struct Workspace* ws, enum Method method);
+void destroyIntegrator(struct Integrator* integrator);
+
+// Returns 0 if the step could not cover dt; only dopri45 can fail, when
+// its error estimate stops being finite.
+int dopri45(struct Integrator* integrator, float dt, float* thetas, float* omegas);
+void gaussLegendre(struct Integrator* integrator, float dt, float* thetas, float* omegas);
+void adamsBashforthMoulton(struct Integrator* integrator, float dt, float* thetas, float* omegas);
+int integrate(struct Integrator* integrator, float dt, float* thetas, float* omegas);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef LYAPUNOV_H
+#define LYAPUNOV_H
+
+#include <stddef.h>
+
+#include "physics.h"
+
+#define LYAPUNOV_RENORMALIZE_STEPS 10
+
+// Lyapunov exponents of an n-link chain from the variational equations.
+// Alongside the state, rk4 carries `count` tangent vectors
+// (dTheta, dOmega) through the linearised flow
+//   dTheta' = dOmega
+//   dOmega' = M^-1 (dB - dM alpha),
+// with dM and dB the derivatives of the mass matrix and right-hand side
+// along the tangent vector. Every tangent shares the state's factorisation
+// of M, so each costs O(n^2) per stage where a finite-difference Jacobian
+// column would cost a whole f(). Every `interval` steps the tangents are
+// re-orthonormalised by Gram-Schmidt (a QR factorisation) and the logs of
+// the stretch factors are accumulated; their time averages are the
+// exponents, largest first.
+//
+// Needs a dense engine, which supplies the factorisation.
+struct Lyapunov {
+  struct Workspace* ws;
+  size_t n;
+  int count;
+  int interval;
+  long steps;
+
+  // Time covered by the sums, and time integrated since the last
+  // orthonormalisation.
+  double time;
+  double pending;
+
+  // count vectors of 2n floats, dTheta then dOmega.
+  float* tangents;
+  double* sums;
+
+  // rk4 stages for the tangents; the state uses the workspace's.
+  float* stageTangents;
+  float* kTangents[4];
+
+  // Per-evaluation scratch: alpha, W (c o x) and W (s o x) for x = omega^2
+  // and alpha, the right-hand side being solved, and the per-tangent
+  // weighted products with their sums.
+  float* alphas;
+  float* omegaSumC;
+  float* omegaSumS;
+  float* alphaSumC;
+  float* alphaSumS;
+  float* rhs;
+  float* products;
+};
+
+struct Lyapunov* createLyapunov(struct Workspace* ws, int count);
+void destroyLyapunov(struct Lyapunov* lyapunov);
+
+void tangentField(struct Lyapunov* lyapunov, const float* thetas, const float* omegas, const float* tangents,
+                  float* dThetas, float* dOmegas, float* dTangents);
+void lyapunovStep(struct Lyapunov* lyapunov, float dt, float* thetas, float* omegas);
+void orthonormalize(struct Lyapunov* lyapunov);
+void lyapunovExponents(const struct Lyapunov* lyapunov, double* exponents);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef PACING_H
+#define PACING_H
+
+// Default time spent spinning before a PACING_DEADLINE deadline. Sleeps
+// overshoot by up to about this much, more on a loaded system or macOS,
+// so the sleep stops short and a spin covers the rest.
+#define PACING_SPIN 0.002
+
+// PACING_VSYNC leaves pacing to glfwSwapInterval(1): the swap blocks until
+// the display takes the frame. PACING_DEADLINE runs with swap interval 0
+// and holds each frame to a fixed period, sleeping most of the wait and
+// spinning the last spin seconds for precision. PACING_UNCAPPED draws as
+// fast as it can. The swap interval is the caller's to set, to match.
+enum PacingMode {
+  PACING_VSYNC,
+  PACING_DEADLINE,
+  PACING_UNCAPPED,
+};
+
+// Frame times and CPU clocks since the stats were last reset. Frame time
+// runs from one pace() to the next.
+struct PacingStats {
+  unsigned long frames;
+  double seconds;
+  double squares;
+  double worst;
+
+  double wallStart;
+  double processStart;
+  double threadStart;
+};
+
+struct PacingReport {
+  double fps;
+  double frameMs;
+  // Standard deviation and worst case of the frame time.
+  double jitterMs;
+  double worstMs;
+  // CPU seconds per wall second: all threads of the process, including
+  // physics, and the pacing thread alone. 1 is one core kept busy.
+  double processLoad;
+  double threadLoad;
+};
+
+struct Pacer {
+  enum PacingMode mode;
+  double period;
+  double spin;
+
+  double deadline;
+  double previous;
+
+  // interval is for the caller to reset on its own schedule; total covers
+  // the whole run.
+  struct PacingStats interval;
+  struct PacingStats total;
+};
+
+// fps only matters for PACING_DEADLINE. Create the pacer on the thread
+// that will call pace().
+struct Pacer* createPacer(enum PacingMode mode, double fps);
+void destroyPacer(struct Pacer* pacer);
+
+// Call once per frame, after the swap. Waits out the rest of the period
+// under PACING_DEADLINE; when a frame runs a whole period late the
+// schedule restarts from now instead of rushing to catch up.
+void pace(struct Pacer* pacer);
+
+// Must be called on the pacer's thread.
+void resetPacingStats(struct PacingStats* stats);
+void pacingReport(const struct PacingStats* stats, struct PacingReport* report);
+
+const char* pacingModeName(enum PacingMode mode);
+
+#endif
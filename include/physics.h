@@ -0,0 +1,112 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <stddef.h>
+
+#define GRAVITY -9.81f
+
+struct ThreadPool;
+
+// How f() turns (thetas, omegas) into angular accelerations. ENGINE_LU
+// assembles the dense mass matrix and factors it, O(n^3) per call.
+// ENGINE_CHOLESKY factors the same matrix as LDL^T in place, using its
+// symmetry to do half the work in a single triangle, and switches to the
+// fixed-length solvers in specialized.h for short chains. ENGINE_ABA runs
+// the recursive articulated-body algorithm, O(n) per call, and never forms
+// the mass matrix at all.
+enum Engine {
+  ENGINE_LU,
+  ENGINE_CHOLESKY,
+  ENGINE_ABA,
+};
+
+// Scratch memory for stepping an n-link chain. Everything the solver
+// pipeline needs is allocated once in createWorkspace(), so f() and rk4()
+// never touch the heap.
+struct Workspace {
+  size_t n;
+  enum Engine engine;
+
+  // Number of f() calls made through this workspace, for comparing
+  // integrators by cost.
+  long evaluations;
+
+  // Per-link bob masses and rod lengths, all 1 unless setChain() says
+  // otherwise, with the suffix sums mu_i = sum_{k >= i} m_k and the moments
+  // mu_i l_i that gravity acts through.
+  float* masses;
+  float* lengths;
+  float* suffixMasses;
+  float* suffixMoments;
+
+  // Dense engines: W_ij = mu_max(i, j) l_i l_j, fixed for a given chain, so
+  // M_ij = W_ij cos(ti - tj); and the per-angle trig terms that
+  // assembleSystem() expands pairwise. For unit masses and lengths W_ij is
+  // n - max(i, j).
+  float* weights;
+  float* sines;
+  float* cosines;
+  float* weightedSines;
+  float* weightedCosines;
+
+  float* A;
+  float* B;
+  float* L;
+  float* U;
+  float* y;
+  float* x;
+
+  // ENGINE_CHOLESKY from BLOCKED_MIN_N links up factors with
+  // blocked_ldlt_decompose() using this panel scratch. Set pool to share
+  // that factorisation across a thread pool's workers; it is NULL, and the
+  // factorisation single-threaded, unless the caller sets it.
+  float* panel;
+  struct ThreadPool* pool;
+
+  float* stageThetas;
+  float* stageOmegas;
+
+  float* kThetas[4];
+  float* kOmegas[4];
+
+  // Articulated-body scratch, in double: the spatial inertias are taken
+  // about the anchor and grow like n^3 for long chains.
+  double* abaPositions;
+  double* abaVelocities;
+  double* abaBias;
+  double* abaU;
+  double* abaD;
+  double* abaTorque;
+};
+
+struct Workspace* createWorkspace(size_t n, enum Engine engine);
+void destroyWorkspace(struct Workspace* ws);
+void setChain(struct Workspace* ws, const float* masses, const float* lengths);
+
+void createMatrixA(size_t n, const float* thetas, float* A);
+void createVectorB(size_t n, const float* thetas, const float* omegas, float* B);
+void assembleSystem(struct Workspace* ws, const float* thetas, const float* omegas);
+void assembleMassMatrix(struct Workspace* ws, const float* thetas);
+
+void lu_decompose(size_t n, const float* A, float* L, float* U);
+void forward_substitution(size_t n, const float* L, const float* B, float* y);
+void backward_substitution(size_t n, const float* U, const float* y, float* x);
+void solveLinearSystem(struct Workspace* ws, const float* A, const float* B, float* result);
+
+void ldlt_decompose(size_t n, float* A);
+void ldlt_substitution(size_t n, const float* LD, float* x);
+void solveSymmetricSystem(struct Workspace* ws, float* A, const float* B, float* result);
+
+void articulatedBodyAccelerations(struct Workspace* ws, const float* thetas, const float* omegas, float* alphas);
+
+double energy(size_t n, const float* thetas, const float* omegas);
+double chainEnergy(const struct Workspace* ws, const float* thetas, const float* omegas);
+
+void generalizedMomenta(struct Workspace* ws, const float* thetas, const float* omegas, float* momenta);
+void generalizedVelocities(struct Workspace* ws, const float* thetas, const float* momenta, float* omegas);
+void hamiltonianField(struct Workspace* ws, const float* thetas, const float* momenta, float* dThetas, float* dMomenta);
+
+void f(struct Workspace* ws, const float* thetas, const float* omegas, float* dThetas, float* dOmegas);
+void rk4(struct Workspace* ws, float dt, float* thetas, float* omegas);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Scoped timing zones, compiled in only with -DPROFILE (make build
+// PROFILE=1). Without it every macro below expands to nothing or a no-op,
+// so instrumented code costs nothing.
+//
+//   PROFILE_SCOPE(ZONE_DRAW) {
+//     drawChain(renderer);
+//   }
+//
+// Each pass through a scope is one sample: it lands in its zone's
+// histogram and, until PROFILE_EVENTS are stored, in the event log behind
+// the Chrome trace. Leaving a scope by return, break or goto skips the
+// sample.
+enum ProfileZone {
+  ZONE_FRAME,        // one whole iteration of the render loop
+  ZONE_GATHER,       // taking the latest snapshot from the physics thread
+  ZONE_UPLOAD,       // waiting for and mapping the streamed angle region
+  ZONE_VERTICES,     // interpolating angles into the mapped region
+  ZONE_DRAW,         // trail and chain draws, including the stream unmap
+  ZONE_SWAP,         // glfwSwapBuffers
+  ZONE_STEP,         // one integrator step, on the physics thread
+  PROFILE_ZONES,
+};
+
+// Events kept for the trace; later ones still reach the histograms.
+#define PROFILE_EVENTS (1 << 20)
+
+// Histogram buckets per doubling of duration, so any percentile is within
+// about 6% of the true value.
+#define PROFILE_SUBBUCKETS 8
+
+#ifdef PROFILE
+
+#define PROFILE_SCOPE(zone)                                                \
+  for (long long profileStart = profileNow(), profileOnce = 1; profileOnce; \
+       profileOnce = 0, profileRecord(zone, profileStart, profileNow()))
+#define PROFILE_THREAD(name) profileThread(name)
+#define PROFILE_WRITE(path) profileWrite(path)
+
+#else
+
+#define PROFILE_SCOPE(zone)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_WRITE(path) ((void)0)
+
+#endif
+
+long long profileNow(void);
+void profileRecord(enum ProfileZone zone, long long start, long long end);
+// Names the calling thread in the trace.
+void profileThread(const char* name);
+// Prints count, mean, p50, p99 and max per zone, and writes them as CSV,
+// or the whole event log as Chrome trace_event JSON when path ends in
+// ".json". Call once every profiled thread has stopped.
+void profileWrite(const char* path);
+
+#endif
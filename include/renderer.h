@@ -0,0 +1,77 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <stddef.h>
+#include <glad/glad.h>
+
+#include "stream.h"
+
+// Draws the chain into whatever framebuffer and viewport are current.
+// Needs an OpenGL 3.3 core context, current on the calling thread, for its
+// whole lifetime; it never touches the window system, so it runs the same
+// on a GLFW window or an offscreen context.
+//
+// The only per-frame upload is the n link angles, written by the caller
+// straight into a streamed texture buffer (see stream.h).
+// The vertex shader rebuilds every rod and bob quad from them in one
+// instanced draw of 2n four-vertex strips, doing the forward kinematics
+// itself: 4 bytes per link per frame instead of the 96 that CPU-built rod
+// and bob quads took. Each vertex sums the links above it, so the GPU work
+// is O(n^2), which is negligible next to the physics at any n the dense
+// engines handle.
+struct Renderer {
+  size_t n;
+
+  GLuint program;
+  GLuint vao;
+
+  struct StreamBuffer* angles;
+  GLuint angleTexture;
+  GLuint linkBuffer;
+  GLuint linkTexture;
+
+  GLint angleBaseLocation;
+};
+
+// lengths and radii hold n floats and colors 3 * n (r, g, b). A bob at
+// angles theta is drawn at anchor + scale * sum_j l_j (sin t_j, cos t_j) in
+// normalised device coordinates. Returns NULL and prints the compiler log
+// if a shader fails to build. load is passed on to createStreamBuffer.
+struct Renderer* createRenderer(size_t n, const float* lengths, const float* radii, const float* colors, float anchorX,
+                                float anchorY, float scale, GLADloadproc load);
+void destroyRenderer(struct Renderer* renderer);
+
+// Returns the n angle slots for the next frame, to be filled before
+// drawChain() and not touched after it.
+float* chainAngles(struct Renderer* renderer);
+void drawChain(struct Renderer* renderer);
+
+// The path of one point, kept on the GPU in a ring of the last capacity
+// positions. Each frame appends one 8-byte sample, overwriting the oldest
+// once full, and the whole trail is one line strip whose alpha fades with
+// age: the per-frame cost is the same for any capacity.
+struct Trail {
+  size_t capacity;
+  size_t count;
+  size_t head;
+
+  GLuint program;
+  GLuint vao;
+  GLuint pointBuffer;
+  GLuint pointTexture;
+
+  GLint headLocation;
+  GLint countLocation;
+};
+
+// Same context requirements as the renderer. Returns NULL and prints the
+// compiler log if a shader fails to build.
+struct Trail* createTrail(size_t capacity, float r, float g, float b);
+void destroyTrail(struct Trail* trail);
+
+// x and y are in normalised device coordinates.
+void appendTrail(struct Trail* trail, float x, float y);
+void clearTrail(struct Trail* trail);
+void drawTrail(struct Trail* trail);
+
+#endif
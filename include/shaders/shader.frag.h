@@ -1,41 +1,30 @@
 unsigned char shaders_shader_frag[] = {
   0x23, 0x76, 0x65, 0x72, 0x73, 0x69, 0x6f, 0x6e, 0x20, 0x33, 0x33, 0x30,
-  0x20, 0x63, 0x6f, 0x72, 0x65, 0x0a, 0x0a, 0x75, 0x6e, 0x69, 0x66, 0x6f,
-  0x72, 0x6d, 0x20, 0x76, 0x65, 0x63, 0x32, 0x20, 0x69, 0x52, 0x65, 0x73,
-  0x6f, 0x6c, 0x75, 0x74, 0x69, 0x6f, 0x6e, 0x3b, 0x0a, 0x75, 0x6e, 0x69,
-  0x66, 0x6f, 0x72, 0x6d, 0x20, 0x76, 0x65, 0x63, 0x33, 0x20, 0x69, 0x43,
-  0x65, 0x6e, 0x74, 0x65, 0x72, 0x3b, 0x0a, 0x75, 0x6e, 0x69, 0x66, 0x6f,
-  0x72, 0x6d, 0x20, 0x66, 0x6c, 0x6f, 0x61, 0x74, 0x20, 0x69, 0x52, 0x61,
-  0x64, 0x69, 0x75, 0x73, 0x3b, 0x0a, 0x75, 0x6e, 0x69, 0x66, 0x6f, 0x72,
-  0x6d, 0x20, 0x76, 0x65, 0x63, 0x33, 0x20, 0x69, 0x43, 0x6f, 0x6c, 0x6f,
-  0x72, 0x3b, 0x0a, 0x0a, 0x6f, 0x75, 0x74, 0x20, 0x76, 0x65, 0x63, 0x34,
-  0x20, 0x46, 0x72, 0x61, 0x67, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x3b, 0x0a,
-  0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x6d, 0x61, 0x69, 0x6e, 0x28, 0x29,
-  0x20, 0x7b, 0x0a, 0x20, 0x20, 0x76, 0x65, 0x63, 0x32, 0x20, 0x63, 0x65,
-  0x6e, 0x74, 0x65, 0x72, 0x20, 0x3d, 0x20, 0x28, 0x69, 0x43, 0x65, 0x6e,
-  0x74, 0x65, 0x72, 0x2e, 0x78, 0x79, 0x20, 0x2a, 0x20, 0x30, 0x2e, 0x35,
-  0x20, 0x2b, 0x20, 0x30, 0x2e, 0x35, 0x29, 0x3b, 0x0a, 0x20, 0x20, 0x66,
-  0x6c, 0x6f, 0x61, 0x74, 0x20, 0x72, 0x61, 0x64, 0x69, 0x75, 0x73, 0x20,
-  0x3d, 0x20, 0x69, 0x52, 0x61, 0x64, 0x69, 0x75, 0x73, 0x3b, 0x0a, 0x20,
-  0x20, 0x76, 0x65, 0x63, 0x32, 0x20, 0x66, 0x72, 0x61, 0x67, 0x43, 0x6f,
-  0x6f, 0x72, 0x64, 0x20, 0x3d, 0x20, 0x67, 0x6c, 0x5f, 0x46, 0x72, 0x61,
-  0x67, 0x43, 0x6f, 0x6f, 0x72, 0x64, 0x2e, 0x78, 0x79, 0x20, 0x2f, 0x20,
-  0x69, 0x52, 0x65, 0x73, 0x6f, 0x6c, 0x75, 0x74, 0x69, 0x6f, 0x6e, 0x2e,
-  0x78, 0x79, 0x20, 0x2a, 0x20, 0x32, 0x2e, 0x30, 0x20, 0x2d, 0x20, 0x28,
-  0x31, 0x2e, 0x35, 0x20, 0x2b, 0x20, 0x30, 0x2e, 0x35, 0x20, 0x2a, 0x20,
-  0x69, 0x52, 0x65, 0x73, 0x6f, 0x6c, 0x75, 0x74, 0x69, 0x6f, 0x6e, 0x2e,
-  0x79, 0x20, 0x2f, 0x20, 0x69, 0x52, 0x65, 0x73, 0x6f, 0x6c, 0x75, 0x74,
-  0x69, 0x6f, 0x6e, 0x2e, 0x78, 0x29, 0x3b, 0x0a, 0x0a, 0x20, 0x20, 0x66,
-  0x6c, 0x6f, 0x61, 0x74, 0x20, 0x64, 0x69, 0x73, 0x74, 0x20, 0x3d, 0x20,
-  0x64, 0x69, 0x73, 0x74, 0x61, 0x6e, 0x63, 0x65, 0x28, 0x66, 0x72, 0x61,
-  0x67, 0x43, 0x6f, 0x6f, 0x72, 0x64, 0x2c, 0x20, 0x69, 0x43, 0x65, 0x6e,
-  0x74, 0x65, 0x72, 0x2e, 0x78, 0x79, 0x20, 0x2a, 0x20, 0x32, 0x29, 0x3b,
-  0x0a, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x64, 0x69, 0x73, 0x74, 0x20,
-  0x3e, 0x20, 0x32, 0x20, 0x2a, 0x20, 0x72, 0x61, 0x64, 0x69, 0x75, 0x73,
-  0x29, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x64, 0x69, 0x73, 0x63,
-  0x61, 0x72, 0x64, 0x3b, 0x0a, 0x20, 0x20, 0x7d, 0x0a, 0x0a, 0x20, 0x20,
-  0x46, 0x72, 0x61, 0x67, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x20, 0x3d, 0x20,
-  0x76, 0x65, 0x63, 0x34, 0x28, 0x69, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x2c,
-  0x20, 0x31, 0x2e, 0x30, 0x29, 0x3b, 0x0a, 0x7d, 0x0a
+  0x20, 0x63, 0x6f, 0x72, 0x65, 0x0a, 0x0a, 0x69, 0x6e, 0x20, 0x76, 0x65,
+  0x63, 0x32, 0x20, 0x76, 0x43, 0x6f, 0x72, 0x6e, 0x65, 0x72, 0x3b, 0x0a,
+  0x66, 0x6c, 0x61, 0x74, 0x20, 0x69, 0x6e, 0x20, 0x76, 0x65, 0x63, 0x33,
+  0x20, 0x76, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x3b, 0x0a, 0x66, 0x6c, 0x61,
+  0x74, 0x20, 0x69, 0x6e, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x76, 0x44, 0x69,
+  0x73, 0x63, 0x3b, 0x0a, 0x0a, 0x6f, 0x75, 0x74, 0x20, 0x76, 0x65, 0x63,
+  0x34, 0x20, 0x46, 0x72, 0x61, 0x67, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x3b,
+  0x0a, 0x0a, 0x2f, 0x2f, 0x20, 0x42, 0x6f, 0x62, 0x73, 0x20, 0x61, 0x72,
+  0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x64, 0x69, 0x73, 0x63, 0x20, 0x69,
+  0x6e, 0x73, 0x63, 0x72, 0x69, 0x62, 0x65, 0x64, 0x20, 0x69, 0x6e, 0x20,
+  0x74, 0x68, 0x65, 0x69, 0x72, 0x20, 0x71, 0x75, 0x61, 0x64, 0x2c, 0x20,
+  0x77, 0x68, 0x61, 0x74, 0x65, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65,
+  0x20, 0x66, 0x72, 0x61, 0x6d, 0x65, 0x62, 0x75, 0x66, 0x66, 0x65, 0x72,
+  0x20, 0x73, 0x69, 0x7a, 0x65, 0x3b, 0x0a, 0x2f, 0x2f, 0x20, 0x72, 0x6f,
+  0x64, 0x73, 0x20, 0x66, 0x69, 0x6c, 0x6c, 0x20, 0x74, 0x68, 0x65, 0x69,
+  0x72, 0x73, 0x2e, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20, 0x6d, 0x61, 0x69,
+  0x6e, 0x28, 0x29, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28,
+  0x76, 0x44, 0x69, 0x73, 0x63, 0x20, 0x21, 0x3d, 0x20, 0x30, 0x20, 0x26,
+  0x26, 0x20, 0x64, 0x6f, 0x74, 0x28, 0x76, 0x43, 0x6f, 0x72, 0x6e, 0x65,
+  0x72, 0x2c, 0x20, 0x76, 0x43, 0x6f, 0x72, 0x6e, 0x65, 0x72, 0x29, 0x20,
+  0x3e, 0x20, 0x31, 0x2e, 0x30, 0x29, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x64, 0x69, 0x73, 0x63, 0x61, 0x72, 0x64, 0x3b, 0x0a, 0x20, 0x20,
+  0x7d, 0x0a, 0x0a, 0x20, 0x20, 0x46, 0x72, 0x61, 0x67, 0x43, 0x6f, 0x6c,
+  0x6f, 0x72, 0x20, 0x3d, 0x20, 0x76, 0x65, 0x63, 0x34, 0x28, 0x76, 0x43,
+  0x6f, 0x6c, 0x6f, 0x72, 0x2c, 0x20, 0x31, 0x2e, 0x30, 0x29, 0x3b, 0x0a,
+  0x7d, 0x0a
 };
-unsigned int shaders_shader_frag_len = 453;
+unsigned int shaders_shader_frag_len = 314;
@@ -0,0 +1,20 @@
+unsigned char shaders_trail_frag[] = {
+  0x23, 0x76, 0x65, 0x72, 0x73, 0x69, 0x6f, 0x6e, 0x20, 0x33, 0x33, 0x30,
+  0x20, 0x63, 0x6f, 0x72, 0x65, 0x0a, 0x0a, 0x69, 0x6e, 0x20, 0x66, 0x6c,
+  0x6f, 0x61, 0x74, 0x20, 0x76, 0x41, 0x6c, 0x70, 0x68, 0x61, 0x3b, 0x0a,
+  0x0a, 0x75, 0x6e, 0x69, 0x66, 0x6f, 0x72, 0x6d, 0x20, 0x76, 0x65, 0x63,
+  0x33, 0x20, 0x75, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x3b, 0x0a, 0x0a, 0x6f,
+  0x75, 0x74, 0x20, 0x76, 0x65, 0x63, 0x34, 0x20, 0x46, 0x72, 0x61, 0x67,
+  0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x3b, 0x0a, 0x0a, 0x2f, 0x2f, 0x20, 0x46,
+  0x61, 0x64, 0x65, 0x73, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x72,
+  0x61, 0x6e, 0x73, 0x70, 0x61, 0x72, 0x65, 0x6e, 0x74, 0x20, 0x61, 0x74,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6f, 0x6c, 0x64, 0x65, 0x73, 0x74, 0x20,
+  0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x20, 0x74, 0x6f, 0x20, 0x6f, 0x70,
+  0x61, 0x71, 0x75, 0x65, 0x20, 0x61, 0x74, 0x20, 0x74, 0x68, 0x65, 0x20,
+  0x6e, 0x65, 0x77, 0x65, 0x73, 0x74, 0x2e, 0x0a, 0x76, 0x6f, 0x69, 0x64,
+  0x20, 0x6d, 0x61, 0x69, 0x6e, 0x28, 0x29, 0x20, 0x7b, 0x0a, 0x20, 0x20,
+  0x46, 0x72, 0x61, 0x67, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x20, 0x3d, 0x20,
+  0x76, 0x65, 0x63, 0x34, 0x28, 0x75, 0x43, 0x6f, 0x6c, 0x6f, 0x72, 0x2c,
+  0x20, 0x76, 0x41, 0x6c, 0x70, 0x68, 0x61, 0x29, 0x3b, 0x0a, 0x7d, 0x0a
+};
+unsigned int shaders_trail_frag_len = 204;
@@ -0,0 +1,52 @@
+unsigned char shaders_trail_vert[] = {
+  0x23, 0x76, 0x65, 0x72, 0x73, 0x69, 0x6f, 0x6e, 0x20, 0x33, 0x33, 0x30,
+  0x20, 0x63, 0x6f, 0x72, 0x65, 0x0a, 0x0a, 0x2f, 0x2f, 0x20, 0x56, 0x65,
+  0x72, 0x74, 0x65, 0x78, 0x20, 0x70, 0x75, 0x6c, 0x6c, 0x69, 0x6e, 0x67,
+  0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x72,
+  0x61, 0x69, 0x6c, 0x27, 0x73, 0x20, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x6f,
+  0x66, 0x20, 0x70, 0x61, 0x73, 0x74, 0x20, 0x74, 0x69, 0x70, 0x20, 0x70,
+  0x6f, 0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x3a, 0x20, 0x76, 0x65,
+  0x72, 0x74, 0x65, 0x78, 0x20, 0x69, 0x20, 0x6f, 0x66, 0x0a, 0x2f, 0x2f,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x74, 0x72, 0x69, 0x70, 0x20, 0x69,
+  0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x69, 0x2d, 0x74, 0x68, 0x20, 0x6f,
+  0x6c, 0x64, 0x65, 0x73, 0x74, 0x20, 0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65,
+  0x2c, 0x20, 0x73, 0x6f, 0x20, 0x74, 0x68, 0x65, 0x20, 0x72, 0x69, 0x6e,
+  0x67, 0x20, 0x69, 0x73, 0x20, 0x64, 0x72, 0x61, 0x77, 0x6e, 0x20, 0x69,
+  0x6e, 0x20, 0x6f, 0x72, 0x64, 0x65, 0x72, 0x0a, 0x2f, 0x2f, 0x20, 0x77,
+  0x69, 0x74, 0x68, 0x6f, 0x75, 0x74, 0x20, 0x65, 0x76, 0x65, 0x72, 0x20,
+  0x62, 0x65, 0x69, 0x6e, 0x67, 0x20, 0x72, 0x6f, 0x74, 0x61, 0x74, 0x65,
+  0x64, 0x20, 0x69, 0x6e, 0x20, 0x6d, 0x65, 0x6d, 0x6f, 0x72, 0x79, 0x2e,
+  0x0a, 0x75, 0x6e, 0x69, 0x66, 0x6f, 0x72, 0x6d, 0x20, 0x73, 0x61, 0x6d,
+  0x70, 0x6c, 0x65, 0x72, 0x42, 0x75, 0x66, 0x66, 0x65, 0x72, 0x20, 0x75,
+  0x50, 0x6f, 0x69, 0x6e, 0x74, 0x73, 0x3b, 0x0a, 0x75, 0x6e, 0x69, 0x66,
+  0x6f, 0x72, 0x6d, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x75, 0x43, 0x61, 0x70,
+  0x61, 0x63, 0x69, 0x74, 0x79, 0x3b, 0x0a, 0x2f, 0x2f, 0x20, 0x4e, 0x65,
+  0x78, 0x74, 0x20, 0x73, 0x6c, 0x6f, 0x74, 0x20, 0x74, 0x6f, 0x20, 0x62,
+  0x65, 0x20, 0x77, 0x72, 0x69, 0x74, 0x74, 0x65, 0x6e, 0x2c, 0x20, 0x61,
+  0x6e, 0x64, 0x20, 0x68, 0x6f, 0x77, 0x20, 0x6d, 0x61, 0x6e, 0x79, 0x20,
+  0x73, 0x6c, 0x6f, 0x74, 0x73, 0x20, 0x68, 0x6f, 0x6c, 0x64, 0x20, 0x73,
+  0x61, 0x6d, 0x70, 0x6c, 0x65, 0x73, 0x2e, 0x0a, 0x75, 0x6e, 0x69, 0x66,
+  0x6f, 0x72, 0x6d, 0x20, 0x69, 0x6e, 0x74, 0x20, 0x75, 0x48, 0x65, 0x61,
+  0x64, 0x3b, 0x0a, 0x75, 0x6e, 0x69, 0x66, 0x6f, 0x72, 0x6d, 0x20, 0x69,
+  0x6e, 0x74, 0x20, 0x75, 0x43, 0x6f, 0x75, 0x6e, 0x74, 0x3b, 0x0a, 0x0a,
+  0x6f, 0x75, 0x74, 0x20, 0x66, 0x6c, 0x6f, 0x61, 0x74, 0x20, 0x76, 0x41,
+  0x6c, 0x70, 0x68, 0x61, 0x3b, 0x0a, 0x0a, 0x76, 0x6f, 0x69, 0x64, 0x20,
+  0x6d, 0x61, 0x69, 0x6e, 0x28, 0x29, 0x0a, 0x7b, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x69, 0x6e, 0x74, 0x20, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x20, 0x3d,
+  0x20, 0x28, 0x75, 0x48, 0x65, 0x61, 0x64, 0x20, 0x2d, 0x20, 0x75, 0x43,
+  0x6f, 0x75, 0x6e, 0x74, 0x20, 0x2b, 0x20, 0x67, 0x6c, 0x5f, 0x56, 0x65,
+  0x72, 0x74, 0x65, 0x78, 0x49, 0x44, 0x20, 0x2b, 0x20, 0x75, 0x43, 0x61,
+  0x70, 0x61, 0x63, 0x69, 0x74, 0x79, 0x29, 0x20, 0x25, 0x20, 0x75, 0x43,
+  0x61, 0x70, 0x61, 0x63, 0x69, 0x74, 0x79, 0x3b, 0x0a, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x76, 0x41, 0x6c, 0x70, 0x68, 0x61, 0x20, 0x3d, 0x20, 0x66,
+  0x6c, 0x6f, 0x61, 0x74, 0x28, 0x67, 0x6c, 0x5f, 0x56, 0x65, 0x72, 0x74,
+  0x65, 0x78, 0x49, 0x44, 0x20, 0x2b, 0x20, 0x31, 0x29, 0x20, 0x2f, 0x20,
+  0x66, 0x6c, 0x6f, 0x61, 0x74, 0x28, 0x75, 0x43, 0x6f, 0x75, 0x6e, 0x74,
+  0x29, 0x3b, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x67, 0x6c, 0x5f, 0x50, 0x6f,
+  0x73, 0x69, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x3d, 0x20, 0x76, 0x65, 0x63,
+  0x34, 0x28, 0x74, 0x65, 0x78, 0x65, 0x6c, 0x46, 0x65, 0x74, 0x63, 0x68,
+  0x28, 0x75, 0x50, 0x6f, 0x69, 0x6e, 0x74, 0x73, 0x2c, 0x20, 0x69, 0x6e,
+  0x64, 0x65, 0x78, 0x29, 0x2e, 0x78, 0x79, 0x2c, 0x20, 0x30, 0x2e, 0x30,
+  0x2c, 0x20, 0x31, 0x2e, 0x30, 0x29, 0x3b, 0x0a, 0x7d, 0x0a
+};
+unsigned int shaders_trail_vert_len = 586;
@@ -0,0 +1,88 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "integrators.h"
+
+#define SIMULATION_CACHE_LINE 64
+
+// Default cap on the steps run in one catch-up; wall time beyond it is
+// dropped rather than simulated.
+#define SIMULATION_MAX_SUBSTEPS 256
+
+// One published state of the chain. previousThetas are the angles one step
+// earlier, for interpolating between the two. lag is the wall time dropped
+// so far, so the state belongs to wall time time + lag after the start.
+// Positions are left to the reader, which needs them only at the
+// interpolated angles.
+struct Snapshot {
+  double time;
+  double lag;
+  unsigned long step;
+  float* thetas;
+  float* omegas;
+  float* previousThetas;
+};
+
+// Runs an integrator on its own thread with a fixed step dt. Each time it
+// wakes it runs as many steps as the wall time since the last batch
+// covers, up to maxSubsteps, publishes once, and sleeps until the next step
+// is due. States go to one reader through a triple buffer. The writer
+// fills its back slot and swaps it into the middle; the reader swaps the
+// middle for its front slot when the middle holds something newer. Both
+// swaps are a single atomic exchange, so neither side ever waits on the
+// other and the reader always sees the latest complete state.
+//
+// Once started, the simulation thread owns the integrator and its
+// workspace until stopSimulation() returns.
+struct Simulation {
+  struct Integrator* integrator;
+  size_t n;
+  float dt;
+  int maxSubsteps;
+
+  // Wall clock the simulation counts from, set by startSimulation().
+  double start;
+
+  // Simulation thread only.
+  float* thetas;
+  float* omegas;
+  float* previousThetas;
+  int back;
+
+  // Reader only.
+  int front;
+
+  struct Snapshot slots[3];
+  _Alignas(SIMULATION_CACHE_LINE) atomic_uint middle;
+
+  pthread_t thread;
+  atomic_int running;
+
+  // Written by the simulation thread, readable from anywhere.
+  _Alignas(SIMULATION_CACHE_LINE) atomic_ulong steps;
+  atomic_ulong batches;
+  atomic_ulong droppedSteps;
+  atomic_ulong busyNanoseconds;
+};
+
+struct Simulation* createSimulation(struct Integrator* integrator, float dt, const float* thetas, const float* omegas);
+void destroySimulation(struct Simulation* simulation);
+
+// Returns 0 and prints why if the thread could not be started.
+int startSimulation(struct Simulation* simulation);
+void stopSimulation(struct Simulation* simulation);
+
+// The newest published state. Stays valid and unchanged until the next
+// call; reader thread only.
+const struct Snapshot* latestSnapshot(struct Simulation* simulation);
+
+// Where the current wall time falls between snapshot's previous and
+// current states, in [0, 1]. The renderer draws one step behind the
+// simulation so that the point is normally bracketed.
+float interpolationWeight(const struct Simulation* simulation, const struct Snapshot* snapshot);
+
+#endif
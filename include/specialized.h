@@ -0,0 +1,21 @@
+#ifndef SPECIALIZED_H
+#define SPECIALIZED_H
+
+#include <stddef.h>
+
+struct Workspace;
+
+// Chains of SPECIALIZED_MIN_N..SPECIALIZED_MAX_N links get a solver
+// compiled for their exact length: every loop has a constant trip count, so
+// the compiler unrolls it and keeps A, B and the trig terms in registers
+// instead of walking workspace buffers. Only the chain's weights and
+// gravity moments are read from the workspace. n = 2 uses the closed-form
+// double pendulum.
+#define SPECIALIZED_MIN_N 2
+#define SPECIALIZED_MAX_N 8
+
+// Writes the angular accelerations and returns 1 if ws->n is in the
+// specialised range; returns 0 and touches nothing otherwise.
+int specializedAccelerations(const struct Workspace* ws, const float* thetas, const float* omegas, float* alphas);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include <glad/glad.h>
+
+// Regions in the persistent ring: the CPU writes one while the GPU may
+// still be reading the other two.
+#define STREAM_REGIONS 3
+
+// STREAM_PERSISTENT maps one buffer of STREAM_REGIONS regions for its whole
+// life (GL 4.4 or ARB_buffer_storage) and fences each region after the
+// draw that reads it; writing a region first waits on its fence, which
+// only blocks if the GPU is a full ring behind. STREAM_ORPHAN is the GL 3.3
+// fallback: every frame re-specifies the store and maps it invalidated, so
+// the driver hands out fresh memory instead of waiting for the old.
+enum StreamMode {
+  STREAM_PERSISTENT,
+  STREAM_ORPHAN,
+};
+
+// Per-frame data written straight into GL-visible memory, with no staging
+// copy. Each frame: beginStream(), write, endStream(), issue the draw
+// reading from streamOffset(), then fenceStream().
+struct StreamBuffer {
+  enum StreamMode mode;
+  GLenum target;
+  GLuint buffer;
+  size_t regionSize;
+
+  unsigned char* mapped;
+  GLsync fences[STREAM_REGIONS];
+  int region;
+
+  // Totals since creation and the figures for the last frame.
+  unsigned long frames;
+  unsigned long long bytes;
+  double waitSeconds;
+  size_t lastBytes;
+  double lastWaitSeconds;
+};
+
+// load resolves GL entry points beyond glad's 3.3 core set (glfwGetProcAddress,
+// eglGetProcAddress); with NULL, or without buffer storage support, the
+// stream orphans.
+struct StreamBuffer* createStreamBuffer(GLenum target, size_t regionSize, GLADloadproc load);
+void destroyStreamBuffer(struct StreamBuffer* stream);
+
+// Returns regionSize writable bytes. The buffer is left bound to target.
+void* beginStream(struct StreamBuffer* stream);
+void endStream(struct StreamBuffer* stream, size_t bytes);
+void fenceStream(struct StreamBuffer* stream);
+
+// Byte offset of the region written last, for the draw that reads it.
+size_t streamOffset(const struct StreamBuffer* stream);
+
+#endif
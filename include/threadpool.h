@@ -0,0 +1,32 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+
+// Called once per task index. worker is in [0, threadPoolWorkers()) and is
+// stable for the duration of the call, so it can index per-worker scratch.
+typedef void (*TaskFunction)(void* context, size_t task, int worker);
+typedef double (*ReduceFunction)(void* context, size_t task, int worker);
+
+// A fixed set of workers, each with its own deque of task indices. A job's
+// tasks are dealt out in contiguous runs, owners pop from the back of their
+// run and idle workers steal from the front of someone else's. The calling
+// thread takes part as worker 0.
+//
+// Work placement never changes what a task computes, but it does change
+// the order in which parallelReduce() adds partial results. With
+// deterministic set, every task's partial is kept and summed in task order,
+// so reductions are bitwise identical for any number of workers; otherwise
+// partials are accumulated per worker.
+struct ThreadPool;
+
+struct ThreadPool* createThreadPool(int workers, int deterministic);
+void destroyThreadPool(struct ThreadPool* pool);
+
+int threadPoolWorkers(const struct ThreadPool* pool);
+int hardwareThreads(void);
+
+void parallelFor(struct ThreadPool* pool, size_t tasks, TaskFunction function, void* context);
+double parallelReduce(struct ThreadPool* pool, size_t tasks, ReduceFunction function, void* context);
+
+#endif
@@ -1,21 +1,17 @@
 #version 330 core
 
-uniform vec2 iResolution;
-uniform vec3 iCenter;
-uniform float iRadius;
-uniform vec3 iColor;
+in vec2 vCorner;
+flat in vec3 vColor;
+flat in int vDisc;
 
 out vec4 FragColor;
 
+// Bobs are the disc inscribed in their quad, whatever the framebuffer size;
+// rods fill theirs.
 void main() {
-  vec2 center = (iCenter.xy * 0.5 + 0.5);
-  float radius = iRadius;
-  vec2 fragCoord = gl_FragCoord.xy / iResolution.xy * 2.0 - (1.5 + 0.5 * iResolution.y / iResolution.x);
-
-  float dist = distance(fragCoord, iCenter.xy * 2);
-  if (dist > 2 * radius) {
+  if (vDisc != 0 && dot(vCorner, vCorner) > 1.0) {
     discard;
   }
 
-  FragColor = vec4(iColor, 1.0);
+  FragColor = vec4(vColor, 1.0);
 }
@@ -1,9 +1,50 @@
 #version 330 core
 
-layout(location = 0) in vec3 aPos;
+// Vertex pulling: there are no vertex attributes. Instances [0, n) are the
+// rods and [n, 2n) the bobs, each a four-vertex strip whose corner comes
+// from gl_VertexID. Bob positions are rebuilt from the link angles, the
+// only per-frame input, by summing the links above each bob.
+uniform samplerBuffer uAngles;
+// First texel of this frame's angles in the streamed ring.
+uniform int uAngleBase;
+// Two texels per link: (length, radius, 0, 0) and (r, g, b, 1). Lengths
+// are already scaled to normalised device coordinates.
+uniform samplerBuffer uLinks;
+uniform int uLinkCount;
+uniform vec2 uAnchor;
+uniform float uRodWidth;
+
+out vec2 vCorner;
+flat out vec3 vColor;
+flat out int vDisc;
 
 void main()
 {
-    gl_Position = vec4(aPos, 1.0);
-}
+    vec2 corner = vec2((gl_VertexID & 1) == 0 ? 1.0 : -1.0, gl_VertexID < 2 ? 1.0 : -1.0);
+    bool bob = gl_InstanceID >= uLinkCount;
+    int link = bob ? gl_InstanceID - uLinkCount : gl_InstanceID;
+
+    vec2 start = uAnchor;
+    vec2 end = uAnchor;
+    for (int j = 0; j <= link; j++) {
+        float theta = texelFetch(uAngles, uAngleBase + j).r;
+        start = end;
+        end += texelFetch(uLinks, 2 * j).x * vec2(sin(theta), cos(theta));
+    }
 
+    vec2 position;
+    if (bob) {
+        position = end + corner * texelFetch(uLinks, 2 * link).y;
+        vColor = texelFetch(uLinks, 2 * link + 1).rgb;
+        vDisc = 1;
+    } else {
+        vec2 d = end - start;
+        vec2 offset = 0.5 * uRodWidth * vec2(-d.y, d.x) / length(d);
+        position = (corner.y > 0.0 ? start : end) + corner.x * offset;
+        vColor = vec3(0.5);
+        vDisc = 0;
+    }
+
+    vCorner = corner;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+
+in float vAlpha;
+
+uniform vec3 uColor;
+
+out vec4 FragColor;
+
+// Fades from transparent at the oldest sample to opaque at the newest.
+void main() {
+  FragColor = vec4(uColor, vAlpha);
+}
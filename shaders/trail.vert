@@ -0,0 +1,20 @@
+#version 330 core
+
+// Vertex pulling from the trail's ring of past tip positions: vertex i of
+// the strip is the i-th oldest sample, so the ring is drawn in order
+// without ever being rotated in memory.
+uniform samplerBuffer uPoints;
+uniform int uCapacity;
+// Next slot to be written, and how many slots hold samples.
+uniform int uHead;
+uniform int uCount;
+
+out float vAlpha;
+
+void main()
+{
+    int index = (uHead - uCount + gl_VertexID + uCapacity) % uCapacity;
+
+    vAlpha = float(gl_VertexID + 1) / float(uCount);
+    gl_Position = vec4(texelFetch(uPoints, index).xy, 0.0, 1.0);
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloccount.h"
+#include "physics.h"
+
+// Steps chains of several lengths through every engine and fails if f()
+// or rk4() touches the heap once the workspace has taken one warm-up step.
+// The sizes cover the fixed-length solvers, the dense path and, for
+// ENGINE_CHOLESKY, the blocked factorisation.
+
+#define STEPS 1000
+#define TIME_STEP 1e-4f
+
+static int check(enum Engine engine, const char* name, size_t n) {
+  struct Workspace* ws = createWorkspace(n, engine);
+  float* thetas = (float*)malloc(n * sizeof(float));
+  float* omegas = (float*)malloc(n * sizeof(float));
+  float* dThetas = (float*)malloc(n * sizeof(float));
+  float* dOmegas = (float*)malloc(n * sizeof(float));
+  for (size_t i = 0; i < n; i++) {
+    thetas[i] = 2.0f + 0.1f * i;
+    omegas[i] = 0.0f;
+  }
+
+  rk4(ws, TIME_STEP, thetas, omegas);
+
+  size_t before = allocationCount();
+  for (int step = 0; step < STEPS; step++) {
+    f(ws, thetas, omegas, dThetas, dOmegas);
+    rk4(ws, TIME_STEP, thetas, omegas);
+  }
+  size_t made = allocationCount() - before;
+
+  printf("%-9s n = %-4zu %zu allocations in %d steps\n", name, n, made, STEPS);
+
+  free(dOmegas);
+  free(dThetas);
+  free(omegas);
+  free(thetas);
+  destroyWorkspace(ws);
+
+  return made == 0;
+}
+
+int main(void) {
+  if (!ALLOCATION_TRACKING) {
+    printf("Allocation counting needs glibc; skipped\n");
+    return 0;
+  }
+
+  static const size_t sizes[] = {2, 6, 40, 300};
+  static const struct {
+    enum Engine engine;
+    const char* name;
+  } engines[] = {
+    {ENGINE_LU, "lu"},
+    {ENGINE_CHOLESKY, "cholesky"},
+    {ENGINE_ABA, "aba"},
+  };
+
+  int failures = 0;
+  for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      failures += !check(engines[e].engine, engines[e].name, sizes[s]);
+    }
+  }
+
+  if (failures > 0) {
+    printf("%d configurations allocate while stepping\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,38 @@
+#include <stdlib.h>
+
+#include "alloccount.h"
+
+static size_t allocations;
+static size_t bytes;
+
+#ifdef __GLIBC__
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* pointer, size_t size);
+
+void* malloc(size_t size) {
+  allocations++;
+  bytes += size;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  allocations++;
+  bytes += count * size;
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+  allocations++;
+  bytes += size;
+  return __libc_realloc(pointer, size);
+}
+#endif
+
+size_t allocationCount(void) {
+  return allocations;
+}
+
+size_t allocatedBytes(void) {
+  return bytes;
+}
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "blocked.h"
+#include "threadpool.h"
+
+#if defined(__GNUC__) && defined(__AVX512F__)
+#define BLOCKED_LANES 16
+#elif defined(__GNUC__) && defined(__AVX__)
+#define BLOCKED_LANES 8
+#elif defined(__GNUC__)
+#define BLOCKED_LANES 4
+#else
+#define BLOCKED_LANES 1
+#endif
+
+// Rows of the panel solve handed out per task.
+#define PANEL_ROWS 64
+
+#if BLOCKED_LANES > 1
+// Rows of A start anywhere, so vector loads must not assume alignment.
+typedef float vfloat __attribute__((vector_size(BLOCKED_LANES * sizeof(float)), __may_alias__, aligned(sizeof(float))));
+#endif
+
+struct Step {
+  size_t n;
+  float* A;
+  float* panel;
+  size_t start;
+  size_t width;
+};
+
+// In-place LDL^T of the width x width diagonal block at (start, start),
+// same scheme as ldlt_decompose() with the row stride of the full matrix.
+static void factorDiagonal(const struct Step* step) {
+  size_t n = step->n;
+  float* base = step->A + step->start * n + step->start;
+
+  for (size_t j = 0; j < step->width; j++) {
+    float* row = base + j * n;
+
+    for (size_t k = 0; k < j; k++) {
+      const float* rowK = base + k * n;
+      float sum = 0;
+      for (size_t m = 0; m < k; m++) {
+        sum += row[m] * rowK[m];
+      }
+      row[k] -= sum;
+    }
+
+    float d = row[j];
+    for (size_t k = 0; k < j; k++) {
+      float l = row[k] / base[k * n + k];
+      d -= l * row[k];
+      row[k] = l;
+    }
+    row[j] = d;
+  }
+}
+
+// Solves rows [first, last) of the panel below the diagonal block against
+// its unit lower factor. Each row is left holding L and its L * D is
+// written transposed into the panel scratch (row k, column i), where the
+// trailing update reads it along contiguous columns.
+static void solvePanelRows(void* context, size_t task, int worker) {
+  const struct Step* step = (const struct Step*)context;
+  size_t n = step->n;
+  size_t width = step->width;
+  const float* diagonal = step->A + step->start * n + step->start;
+
+  size_t first = step->start + width + task * PANEL_ROWS;
+  size_t last = first + PANEL_ROWS < n ? first + PANEL_ROWS : n;
+
+  for (size_t i = first; i < last; i++) {
+    float* row = step->A + i * n + step->start;
+
+    for (size_t k = 0; k < width; k++) {
+      const float* rowK = diagonal + k * n;
+      float sum = 0;
+      for (size_t m = 0; m < k; m++) {
+        sum += row[m] * rowK[m];
+      }
+      row[k] -= sum;
+    }
+
+    for (size_t k = 0; k < width; k++) {
+      step->panel[k * n + i] = row[k];
+      row[k] /= diagonal[k * n + k];
+    }
+  }
+}
+
+// out[j] -= sum_k l[k] * panel[k][j] for j in [0, count). Four vectors of
+// out stay in registers across the whole k loop.
+static void updateRow(float* out, const float* l, const float* panel, size_t stride, size_t width, size_t count) {
+  size_t j = 0;
+
+#if BLOCKED_LANES > 1
+  for (; j + 4 * BLOCKED_LANES <= count; j += 4 * BLOCKED_LANES) {
+    vfloat* o = (vfloat*)(out + j);
+    vfloat acc0 = o[0], acc1 = o[1], acc2 = o[2], acc3 = o[3];
+
+    for (size_t k = 0; k < width; k++) {
+      const vfloat* p = (const vfloat*)(panel + k * stride + j);
+      float a = l[k];
+      acc0 -= a * p[0];
+      acc1 -= a * p[1];
+      acc2 -= a * p[2];
+      acc3 -= a * p[3];
+    }
+
+    o[0] = acc0; o[1] = acc1; o[2] = acc2; o[3] = acc3;
+  }
+
+  for (; j + BLOCKED_LANES <= count; j += BLOCKED_LANES) {
+    vfloat* o = (vfloat*)(out + j);
+    vfloat acc = *o;
+    for (size_t k = 0; k < width; k++) {
+      acc -= l[k] * *(const vfloat*)(panel + k * stride + j);
+    }
+    *o = acc;
+  }
+#endif
+
+  for (; j < count; j++) {
+    float acc = out[j];
+    for (size_t k = 0; k < width; k++) {
+      acc -= l[k] * panel[k * stride + j];
+    }
+    out[j] = acc;
+  }
+}
+
+// updateRow() for two rows of the same length, so each panel vector loaded
+// feeds two rows' multiply-adds.
+static void updateRowPair(float* out0, float* out1, const float* l0, const float* l1, const float* panel, size_t stride,
+                          size_t width, size_t count) {
+  size_t j = 0;
+
+#if BLOCKED_LANES > 1
+  for (; j + 4 * BLOCKED_LANES <= count; j += 4 * BLOCKED_LANES) {
+    vfloat* o0 = (vfloat*)(out0 + j);
+    vfloat* o1 = (vfloat*)(out1 + j);
+    vfloat a0 = o0[0], a1 = o0[1], a2 = o0[2], a3 = o0[3];
+    vfloat b0 = o1[0], b1 = o1[1], b2 = o1[2], b3 = o1[3];
+
+    for (size_t k = 0; k < width; k++) {
+      const vfloat* p = (const vfloat*)(panel + k * stride + j);
+      vfloat p0 = p[0], p1 = p[1], p2 = p[2], p3 = p[3];
+      float x = l0[k], y = l1[k];
+      a0 -= x * p0; a1 -= x * p1; a2 -= x * p2; a3 -= x * p3;
+      b0 -= y * p0; b1 -= y * p1; b2 -= y * p2; b3 -= y * p3;
+    }
+
+    o0[0] = a0; o0[1] = a1; o0[2] = a2; o0[3] = a3;
+    o1[0] = b0; o1[1] = b1; o1[2] = b2; o1[3] = b3;
+  }
+#endif
+
+  if (j < count) {
+    updateRow(out0 + j, l0, panel + j, stride, width, count - j);
+    updateRow(out1 + j, l1, panel + j, stride, width, count - j);
+  }
+}
+
+// Trailing update restricted to columns [jb, jb + BLOCKED_TILE): every row
+// at or below the tile's first column loses L * (L D)^T over the panel.
+// Tiles own disjoint columns, so they can run concurrently.
+static void updateTile(void* context, size_t task, int worker) {
+  const struct Step* step = (const struct Step*)context;
+  size_t n = step->n;
+  size_t trailing = step->start + step->width;
+  size_t jb = trailing + task * BLOCKED_TILE;
+  size_t je = jb + BLOCKED_TILE < n ? jb + BLOCKED_TILE : n;
+
+  // Rows inside the tile stop at the diagonal; below it every row spans
+  // the whole tile and they go in pairs.
+  size_t i = jb;
+  for (; i < je; i++) {
+    float* row = step->A + i * n;
+    updateRow(row + jb, row + step->start, step->panel + jb, n, step->width, i + 1 - jb);
+  }
+
+  for (; i + 1 < n; i += 2) {
+    float* row0 = step->A + i * n;
+    float* row1 = row0 + n;
+    updateRowPair(row0 + jb, row1 + jb, row0 + step->start, row1 + step->start, step->panel + jb, n, step->width, je - jb);
+  }
+
+  if (i < n) {
+    float* row = step->A + i * n;
+    updateRow(row + jb, row + step->start, step->panel + jb, n, step->width, je - jb);
+  }
+}
+
+static void run(struct ThreadPool* pool, size_t tasks, TaskFunction function, void* context) {
+  if (pool != NULL) {
+    parallelFor(pool, tasks, function, context);
+  } else {
+    for (size_t task = 0; task < tasks; task++) {
+      function(context, task, 0);
+    }
+  }
+}
+
+void blocked_ldlt_decompose(size_t n, float* A, float* scratch, struct ThreadPool* pool) {
+  struct Step step = {n, A, scratch, 0, 0};
+
+  for (size_t start = 0; start < n; start += BLOCKED_PANEL) {
+    step.start = start;
+    step.width = start + BLOCKED_PANEL < n ? BLOCKED_PANEL : n - start;
+    factorDiagonal(&step);
+
+    size_t rest = n - start - step.width;
+    if (rest == 0) {
+      break;
+    }
+
+    run(pool, (rest + PANEL_ROWS - 1) / PANEL_ROWS, solvePanelRows, &step);
+    run(pool, (rest + BLOCKED_TILE - 1) / BLOCKED_TILE, updateTile, &step);
+  }
+}
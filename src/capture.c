@@ -0,0 +1,243 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "capture.h"
+
+#define FENCE_TIMEOUT_NS 1000000
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int endsWith(const char* string, const char* suffix) {
+  size_t length = strlen(string), suffixLength = strlen(suffix);
+  return length >= suffixLength && strcmp(string + length - suffixLength, suffix) == 0;
+}
+
+// Frames arrive as RGBA rows from bottom to top. Y4M frames are BT.601
+// studio-range 4:4:4 planes, PPM frames RGB, both top to bottom.
+static void writeFrame(struct Capture* capture, const unsigned char* frame, unsigned char* out, unsigned long index) {
+  int width = capture->width, height = capture->height;
+  size_t pixels = (size_t)width * height;
+
+  for (int row = 0; row < height; row++) {
+    const unsigned char* in = frame + 4 * (size_t)(height - 1 - row) * width;
+    for (int column = 0; column < width; column++, in += 4) {
+      size_t p = (size_t)row * width + column;
+      int r = in[0], g = in[1], b = in[2];
+
+      if (capture->y4m) {
+        out[p] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        out[pixels + p] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        out[2 * pixels + p] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+      } else {
+        memcpy(out + 3 * p, in, 3);
+      }
+    }
+  }
+
+  if (capture->y4m) {
+    fputs("FRAME\n", capture->file);
+    fwrite(out, 1, 3 * pixels, capture->file);
+    return;
+  }
+
+  char path[1024];
+  snprintf(path, sizeof(path), capture->path, (int)index);
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    printf("Failed to open %s\n", path);
+    return;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", width, height);
+  fwrite(out, 1, 3 * pixels, file);
+  fclose(file);
+}
+
+static void* writerMain(void* argument) {
+  struct Capture* capture = (struct Capture*)argument;
+  unsigned char* out = (unsigned char*)malloc(3 * (size_t)capture->width * capture->height);
+
+  for (;;) {
+    pthread_mutex_lock(&capture->lock);
+    while (capture->written == capture->queued && !capture->stopping) {
+      pthread_cond_wait(&capture->ready, &capture->lock);
+    }
+    if (capture->written == capture->queued) {
+      pthread_mutex_unlock(&capture->lock);
+      break;
+    }
+    unsigned long index = capture->written;
+    pthread_mutex_unlock(&capture->lock);
+
+    // The render thread never touches a queued frame until it is written.
+    writeFrame(capture, capture->queue[index % CAPTURE_QUEUE], out, index);
+
+    pthread_mutex_lock(&capture->lock);
+    capture->written++;
+    pthread_cond_signal(&capture->space);
+    pthread_mutex_unlock(&capture->lock);
+  }
+
+  free(out);
+  return NULL;
+}
+
+// Moves the frame read into pbos[slot] onto the writer's queue.
+static void collect(struct Capture* capture, int slot) {
+  size_t size = 4 * (size_t)capture->width * capture->height;
+
+  double start = now();
+  while (glClientWaitSync(capture->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS) == GL_TIMEOUT_EXPIRED) {
+  }
+  glDeleteSync(capture->fences[slot]);
+  capture->fences[slot] = NULL;
+  capture->fenceSeconds += now() - start;
+
+  start = now();
+  pthread_mutex_lock(&capture->lock);
+  while (capture->queued - capture->written >= CAPTURE_QUEUE) {
+    pthread_cond_wait(&capture->space, &capture->lock);
+  }
+  unsigned char* frame = capture->queue[capture->queued % CAPTURE_QUEUE];
+  pthread_mutex_unlock(&capture->lock);
+  capture->stallSeconds += now() - start;
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[slot]);
+  const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+  if (pixels != NULL) {
+    memcpy(frame, pixels, size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  if (pixels == NULL) {
+    printf("Failed to map a captured frame\n");
+    return;
+  }
+
+  pthread_mutex_lock(&capture->lock);
+  capture->queued++;
+  pthread_cond_signal(&capture->ready);
+  pthread_mutex_unlock(&capture->lock);
+}
+
+struct Capture* createCapture(int width, int height, int fps, const char* path) {
+  struct Capture* capture = (struct Capture*)calloc(1, sizeof(struct Capture));
+  capture->width = width;
+  capture->height = height;
+  capture->path = path;
+  capture->y4m = endsWith(path, ".y4m");
+
+  if (capture->y4m) {
+    capture->file = fopen(path, "wb");
+    if (capture->file == NULL) {
+      printf("Failed to open %s\n", path);
+      free(capture);
+      return NULL;
+    }
+    fprintf(capture->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+  }
+
+  glGenFramebuffers(1, &capture->framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, capture->framebuffer);
+  glGenRenderbuffers(1, &capture->colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, capture->colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, capture->colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  size_t size = 4 * (size_t)width * height;
+  glGenBuffers(CAPTURE_PBOS, capture->pbos);
+  for (int i = 0; i < CAPTURE_PBOS; i++) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[i]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size, NULL, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  for (int i = 0; i < CAPTURE_QUEUE; i++) {
+    capture->queue[i] = (unsigned char*)malloc(size);
+  }
+
+  pthread_mutex_init(&capture->lock, NULL);
+  pthread_cond_init(&capture->ready, NULL);
+  pthread_cond_init(&capture->space, NULL);
+  pthread_create(&capture->thread, NULL, writerMain, capture);
+
+  return capture;
+}
+
+void destroyCapture(struct Capture* capture) {
+  if (capture == NULL) {
+    return;
+  }
+
+  // Oldest first, so frames reach the writer in order.
+  for (int i = 0; i < CAPTURE_PBOS; i++) {
+    int slot = (capture->next + i) % CAPTURE_PBOS;
+    if (capture->fences[slot] != NULL) {
+      collect(capture, slot);
+    }
+  }
+
+  pthread_mutex_lock(&capture->lock);
+  capture->stopping = 1;
+  pthread_cond_signal(&capture->ready);
+  pthread_mutex_unlock(&capture->lock);
+  pthread_join(capture->thread, NULL);
+
+  pthread_cond_destroy(&capture->space);
+  pthread_cond_destroy(&capture->ready);
+  pthread_mutex_destroy(&capture->lock);
+
+  if (capture->file != NULL) {
+    fclose(capture->file);
+  }
+
+  glDeleteBuffers(CAPTURE_PBOS, capture->pbos);
+  glDeleteRenderbuffers(1, &capture->colorBuffer);
+  glDeleteFramebuffers(1, &capture->framebuffer);
+
+  for (int i = 0; i < CAPTURE_QUEUE; i++) {
+    free(capture->queue[i]);
+  }
+  free(capture);
+}
+
+void beginCapture(struct Capture* capture) {
+  glBindFramebuffer(GL_FRAMEBUFFER, capture->framebuffer);
+  glViewport(0, 0, capture->width, capture->height);
+}
+
+void endCapture(struct Capture* capture) {
+  double start = now();
+
+  int slot = capture->next;
+  if (capture->fences[slot] != NULL) {
+    collect(capture, slot);
+  }
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, capture->framebuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[slot]);
+  glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  capture->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  capture->next = (slot + 1) % CAPTURE_PBOS;
+  capture->frames++;
+  capture->seconds += now() - start;
+}
+
+void presentCapture(const struct Capture* capture, int width, int height) {
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, capture->framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, capture->width, capture->height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,390 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "ensemble.h"
+#include "physics.h"
+#include "threadpool.h"
+
+#if ENSEMBLE_LANES > 1
+typedef float vfloat __attribute__((vector_size(ENSEMBLE_LANES * sizeof(float)), __may_alias__));
+typedef int32_t vint __attribute__((vector_size(ENSEMBLE_LANES * sizeof(int32_t)), __may_alias__));
+
+// sin and cos of every lane at once. The argument is reduced by the
+// nearest multiple of pi/2 (three-part Cody-Waite constants, good to a few
+// ulp for |x| up to ~1e4), both Cephes minimax polynomials are evaluated
+// on [-pi/4, pi/4], and the quadrant swaps and negates them.
+static void vsincos(vfloat x, vfloat* sine, vfloat* cosine) {
+  const float shifter = 12582912.0f; // 1.5 * 2^23: adding it rounds to nearest
+
+  vfloat k = (x * 0.63661977236758134f + shifter) - shifter;
+  vfloat r = x - k * 1.5703125f;
+  r = r - k * 4.837512969970703125e-4f;
+  r = r - k * 7.54978995489188216e-8f;
+
+  vfloat r2 = r * r;
+  vfloat ps = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+  vfloat pc = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+  vint q = __builtin_convertvector(k, vint);
+  vint swap = -(q & 1);
+  vint sinSign = (q & 2) << 30;
+  vint cosSign = ((q + 1) & 2) << 30;
+
+  vint s = ((vint)pc & swap) | ((vint)ps & ~swap);
+  vint c = ((vint)ps & swap) | ((vint)pc & ~swap);
+
+  *sine = (vfloat)(s ^ sinSign);
+  *cosine = (vfloat)(c ^ cosSign);
+}
+#else
+typedef float vfloat;
+
+static void vsincos(vfloat x, vfloat* sine, vfloat* cosine) {
+  *sine = sinf(x);
+  *cosine = cosf(x);
+}
+#endif
+
+static void* allocVectors(size_t count) {
+  void* p = aligned_alloc(sizeof(vfloat), count * sizeof(vfloat));
+  memset(p, 0, count * sizeof(vfloat));
+  return p;
+}
+
+struct EnsembleScratch* createEnsembleScratch(size_t n) {
+  struct EnsembleScratch* scratch = (struct EnsembleScratch*)calloc(1, sizeof(struct EnsembleScratch));
+
+  scratch->A = (float*)allocVectors(n * n);
+  scratch->B = (float*)allocVectors(n);
+  scratch->sines = (float*)allocVectors(n);
+  scratch->cosines = (float*)allocVectors(n);
+  scratch->omegaSines = (float*)allocVectors(n);
+  scratch->omegaCosines = (float*)allocVectors(n);
+
+  scratch->stageThetas = (float*)allocVectors(n);
+  scratch->stageOmegas = (float*)allocVectors(n);
+
+  for (int s = 0; s < 4; s++) {
+    scratch->kThetas[s] = (float*)allocVectors(n);
+    scratch->kOmegas[s] = (float*)allocVectors(n);
+  }
+
+  return scratch;
+}
+
+void destroyEnsembleScratch(struct EnsembleScratch* scratch) {
+  if (scratch == NULL) {
+    return;
+  }
+
+  for (int s = 0; s < 4; s++) {
+    free(scratch->kThetas[s]);
+    free(scratch->kOmegas[s]);
+  }
+
+  free(scratch->stageThetas);
+  free(scratch->stageOmegas);
+
+  free(scratch->omegaCosines);
+  free(scratch->omegaSines);
+  free(scratch->cosines);
+  free(scratch->sines);
+  free(scratch->B);
+  free(scratch->A);
+
+  free(scratch);
+}
+
+struct Ensemble* createEnsemble(size_t n, size_t count) {
+  struct Ensemble* ensemble = (struct Ensemble*)calloc(1, sizeof(struct Ensemble));
+  ensemble->n = n;
+  ensemble->count = count;
+  ensemble->blocks = (count + ENSEMBLE_LANES - 1) / ENSEMBLE_LANES;
+
+  ensemble->weights = (float*)calloc(n * n, sizeof(float));
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      ensemble->weights[i * n + j] = (float)(n - (i > j ? i : j));
+    }
+  }
+
+  ensemble->thetas = (float*)allocVectors(ensemble->blocks * n);
+  ensemble->omegas = (float*)allocVectors(ensemble->blocks * n);
+
+  ensemble->scratch = createEnsembleScratch(n);
+
+  return ensemble;
+}
+
+void destroyEnsemble(struct Ensemble* ensemble) {
+  if (ensemble == NULL) {
+    return;
+  }
+
+  for (int w = 0; w < ensemble->workerScratchCount; w++) {
+    destroyEnsembleScratch(ensemble->workerScratch[w]);
+  }
+  free(ensemble->workerScratch);
+  destroyEnsembleScratch(ensemble->scratch);
+
+  free(ensemble->omegas);
+  free(ensemble->thetas);
+  free(ensemble->weights);
+
+  free(ensemble);
+}
+
+void setEnsembleChain(struct Ensemble* ensemble, size_t chain, const float* thetas, const float* omegas) {
+  size_t n = ensemble->n;
+  size_t base = (chain / ENSEMBLE_LANES) * n * ENSEMBLE_LANES + chain % ENSEMBLE_LANES;
+
+  for (size_t i = 0; i < n; i++) {
+    ensemble->thetas[base + i * ENSEMBLE_LANES] = thetas[i];
+    ensemble->omegas[base + i * ENSEMBLE_LANES] = omegas[i];
+  }
+}
+
+void getEnsembleChain(const struct Ensemble* ensemble, size_t chain, float* thetas, float* omegas) {
+  size_t n = ensemble->n;
+  size_t base = (chain / ENSEMBLE_LANES) * n * ENSEMBLE_LANES + chain % ENSEMBLE_LANES;
+
+  for (size_t i = 0; i < n; i++) {
+    thetas[i] = ensemble->thetas[base + i * ENSEMBLE_LANES];
+    omegas[i] = ensemble->omegas[base + i * ENSEMBLE_LANES];
+  }
+}
+
+// f() for a block of chains: the same trig-factored assembly and in-place
+// LDL^T as the scalar ENGINE_CHOLESKY path, with every scalar replaced by
+// a lane vector. The weights are shared by all chains and broadcast.
+static void blockDerivative(size_t n, const float* W, struct EnsembleScratch* scratch,
+                            const vfloat* thetas, const vfloat* omegas, vfloat* dThetas, vfloat* dOmegas) {
+  vfloat* A = (vfloat*)scratch->A;
+  vfloat* B = (vfloat*)scratch->B;
+  vfloat* s = (vfloat*)scratch->sines;
+  vfloat* c = (vfloat*)scratch->cosines;
+  vfloat* omegaS = (vfloat*)scratch->omegaSines;
+  vfloat* omegaC = (vfloat*)scratch->omegaCosines;
+
+  for (size_t i = 0; i < n; i++) {
+    vsincos(thetas[i], &s[i], &c[i]);
+
+    vfloat omega2 = omegas[i] * omegas[i];
+    omegaS[i] = omega2 * s[i];
+    omegaC[i] = omega2 * c[i];
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    const float* row = W + i * n;
+    vfloat* out = A + i * n;
+    vfloat si = s[i], ci = c[i];
+
+    vfloat sumC = {0}, sumS = {0};
+    for (size_t j = 0; j < n; j++) {
+      out[j] = row[j] * (ci * c[j] + si * s[j]);
+      sumC += row[j] * omegaC[j];
+      sumS += row[j] * omegaS[j];
+    }
+
+    B[i] = -si * sumC + ci * sumS - (float)(n - i) * GRAVITY * si;
+  }
+
+  for (size_t j = 0; j < n; j++) {
+    vfloat* row = A + j * n;
+
+    for (size_t k = 0; k < j; k++) {
+      const vfloat* rowK = A + k * n;
+      vfloat sum = {0};
+      for (size_t m = 0; m < k; m++) {
+        sum += row[m] * rowK[m];
+      }
+      row[k] -= sum;
+    }
+
+    vfloat d = row[j];
+    for (size_t k = 0; k < j; k++) {
+      vfloat l = row[k] / A[k * n + k];
+      d -= l * row[k];
+      row[k] = l;
+    }
+    row[j] = d;
+  }
+
+  vfloat* x = dOmegas;
+  for (size_t i = 0; i < n; i++) {
+    const vfloat* row = A + i * n;
+    vfloat sum = B[i];
+    for (size_t k = 0; k < i; k++) {
+      sum -= row[k] * x[k];
+    }
+    x[i] = sum;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    x[i] /= A[i * n + i];
+  }
+
+  for (size_t k = n; k-- > 0;) {
+    const vfloat* row = A + k * n;
+    vfloat xk = x[k];
+    for (size_t i = 0; i < k; i++) {
+      x[i] -= row[i] * xk;
+    }
+  }
+
+  memcpy(dThetas, omegas, n * sizeof(vfloat));
+}
+
+void stepEnsembleBlocks(struct Ensemble* ensemble, struct EnsembleScratch* scratch, float dt, size_t firstBlock, size_t lastBlock) {
+  size_t n = ensemble->n;
+  const float* W = ensemble->weights;
+
+  vfloat** kT = (vfloat**)scratch->kThetas;
+  vfloat** kO = (vfloat**)scratch->kOmegas;
+  vfloat* sT = (vfloat*)scratch->stageThetas;
+  vfloat* sO = (vfloat*)scratch->stageOmegas;
+
+  for (size_t b = firstBlock; b < lastBlock; b++) {
+    vfloat* thetas = (vfloat*)ensemble->thetas + b * n;
+    vfloat* omegas = (vfloat*)ensemble->omegas + b * n;
+
+    blockDerivative(n, W, scratch, thetas, omegas, kT[0], kO[0]);
+
+    for (size_t i = 0; i < n; i++) {
+      sT[i] = thetas[i] + (dt / 2.0f) * kT[0][i];
+      sO[i] = omegas[i] + (dt / 2.0f) * kO[0][i];
+    }
+    blockDerivative(n, W, scratch, sT, sO, kT[1], kO[1]);
+
+    for (size_t i = 0; i < n; i++) {
+      sT[i] = thetas[i] + (dt / 2.0f) * kT[1][i];
+      sO[i] = omegas[i] + (dt / 2.0f) * kO[1][i];
+    }
+    blockDerivative(n, W, scratch, sT, sO, kT[2], kO[2]);
+
+    for (size_t i = 0; i < n; i++) {
+      sT[i] = thetas[i] + dt * kT[2][i];
+      sO[i] = omegas[i] + dt * kO[2][i];
+    }
+    blockDerivative(n, W, scratch, sT, sO, kT[3], kO[3]);
+
+    for (size_t i = 0; i < n; i++) {
+      thetas[i] += (kT[0][i] + 2.0f * kT[1][i] + 2.0f * kT[2][i] + kT[3][i]) * (dt / 6.0f);
+      omegas[i] += (kO[0][i] + 2.0f * kO[1][i] + 2.0f * kO[2][i] + kO[3][i]) * (dt / 6.0f);
+    }
+  }
+}
+
+void stepEnsemble(struct Ensemble* ensemble, float dt) {
+  stepEnsembleBlocks(ensemble, ensemble->scratch, dt, 0, ensemble->blocks);
+}
+
+struct ShardJob {
+  struct Ensemble* ensemble;
+  float dt;
+  long steps;
+  size_t shardBlocks;
+};
+
+static size_t cacheShardBlocks(const struct Ensemble* ensemble) {
+  size_t blockBytes = 2 * ensemble->n * sizeof(vfloat);
+  size_t blocks = ENSEMBLE_SHARD_BYTES / blockBytes;
+  return blocks > 0 ? blocks : 1;
+}
+
+static void ensureWorkerScratch(struct Ensemble* ensemble, int workers) {
+  if (ensemble->workerScratchCount >= workers) {
+    return;
+  }
+
+  ensemble->workerScratch = (struct EnsembleScratch**)realloc(ensemble->workerScratch, workers * sizeof(struct EnsembleScratch*));
+  for (int w = ensemble->workerScratchCount; w < workers; w++) {
+    ensemble->workerScratch[w] = createEnsembleScratch(ensemble->n);
+  }
+  ensemble->workerScratchCount = workers;
+}
+
+// Each task takes its shard through every step before moving on, so the
+// shard is loaded into cache once per call rather than once per step.
+static void stepShard(void* context, size_t task, int worker) {
+  struct ShardJob* job = (struct ShardJob*)context;
+  struct Ensemble* ensemble = job->ensemble;
+
+  size_t first = task * job->shardBlocks;
+  size_t last = first + job->shardBlocks;
+  if (last > ensemble->blocks) {
+    last = ensemble->blocks;
+  }
+
+  for (long s = 0; s < job->steps; s++) {
+    stepEnsembleBlocks(ensemble, ensemble->workerScratch[worker], job->dt, first, last);
+  }
+}
+
+// Every chain sees the same arithmetic whichever worker steps it, so the
+// result is bitwise independent of the thread count and of how the blocks
+// are sharded. Shards shrink below the cache size when there would
+// otherwise be too few to keep every worker busy.
+void stepEnsembleParallel(struct Ensemble* ensemble, struct ThreadPool* pool, float dt, long steps) {
+  int workers = threadPoolWorkers(pool);
+  ensureWorkerScratch(ensemble, workers);
+
+  size_t shardBlocks = cacheShardBlocks(ensemble);
+  size_t balanced = (ensemble->blocks + 4 * workers - 1) / (4 * workers);
+  if (balanced < shardBlocks) {
+    shardBlocks = balanced > 0 ? balanced : 1;
+  }
+
+  struct ShardJob job = {ensemble, dt, steps, shardBlocks};
+  parallelFor(pool, (ensemble->blocks + shardBlocks - 1) / shardBlocks, stepShard, &job);
+}
+
+static double shardEnergy(void* context, size_t task, int worker) {
+  struct ShardJob* job = (struct ShardJob*)context;
+  struct Ensemble* ensemble = job->ensemble;
+  struct EnsembleScratch* scratch = ensemble->workerScratch[worker];
+
+  size_t first = task * job->shardBlocks * ENSEMBLE_LANES;
+  size_t last = first + job->shardBlocks * ENSEMBLE_LANES;
+  if (last > ensemble->count) {
+    last = ensemble->count;
+  }
+
+  double total = 0;
+  for (size_t c = first; c < last; c++) {
+    getEnsembleChain(ensemble, c, scratch->stageThetas, scratch->stageOmegas);
+    total += energy(ensemble->n, scratch->stageThetas, scratch->stageOmegas);
+  }
+
+  return total;
+}
+
+// Total energy over all chains. The shards here are always cache-sized,
+// never balanced against the worker count, so that a deterministic pool
+// adds the same partials in the same order for any number of threads.
+double ensembleEnergy(struct Ensemble* ensemble, struct ThreadPool* pool) {
+  ensureWorkerScratch(ensemble, threadPoolWorkers(pool));
+
+  struct ShardJob job = {ensemble, 0, 0, cacheShardBlocks(ensemble)};
+  return parallelReduce(pool, (ensemble->blocks + job.shardBlocks - 1) / job.shardBlocks, shardEnergy, &job);
+}
+
+const char* ensembleInstructionSet(void) {
+#if ENSEMBLE_LANES == 1
+  return "scalar";
+#elif defined(__AVX512F__)
+  return "AVX-512";
+#elif defined(__AVX2__)
+  return "AVX2";
+#elif defined(__AVX__)
+  return "AVX";
+#elif defined(__ARM_NEON)
+  return "NEON";
+#elif defined(__SSE2__)
+  return "SSE2";
+#else
+  return "generic vector";
+#endif
+}
@@ -0,0 +1,259 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "physics.h"
+#include "threadpool.h"
+
+// Time-to-flip map of the double pendulum. Pixel (x, y) starts at rest with
+// the two links at angles phi1, phi2 in (-pi, pi) from hanging straight
+// down, phi1 along x and phi2 up y, and is integrated until either link
+// swings over the top or the time limit runs out.
+//
+// Outputs <prefix>.ppm, coloured by log flip time with black for pixels
+// that never flipped, and <prefix>.f32: W * H native-endian floats in row
+// order holding the flip time in seconds, or -1 for no flip.
+
+#define LINKS 2
+
+#define DEFAULT_WIDTH 256
+#define DEFAULT_HEIGHT 256
+#define DEFAULT_SECONDS 30.0f
+#define DEFAULT_STEP 0.01f
+#define DEFAULT_PREFIX "flipmap"
+
+#define PI 3.14159265358979323846f
+
+#define NO_FLIP -1.0f
+
+struct Options {
+  int width;
+  int height;
+  float seconds;
+  float dt;
+  int threads;
+  const char* prefix;
+};
+
+struct Job {
+  const struct Options* options;
+  struct Workspace** workspaces;
+  float* times;
+  long steps;
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char* program) {
+  printf("usage: %s [-w width] [-h height] [-t seconds] [-d dt] [-j threads] [-o prefix]\n", program);
+}
+
+static int parseOptions(int argc, char** argv, struct Options* options) {
+  options->width = DEFAULT_WIDTH;
+  options->height = DEFAULT_HEIGHT;
+  options->seconds = DEFAULT_SECONDS;
+  options->dt = DEFAULT_STEP;
+  options->threads = 0;
+  options->prefix = DEFAULT_PREFIX;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+      usage(argv[0]);
+      return 0;
+    }
+
+    const char* value = argv[++i];
+
+    switch (argv[i - 1][1]) {
+      case 'w':
+        options->width = atoi(value);
+        break;
+      case 'h':
+        options->height = atoi(value);
+        break;
+      case 't':
+        options->seconds = strtof(value, NULL);
+        break;
+      case 'd':
+        options->dt = strtof(value, NULL);
+        break;
+      case 'j':
+        options->threads = atoi(value);
+        break;
+      case 'o':
+        options->prefix = value;
+        break;
+      default:
+        usage(argv[0]);
+        return 0;
+    }
+  }
+
+  if (options->width <= 0 || options->height <= 0 || options->seconds <= 0 || options->dt <= 0) {
+    usage(argv[0]);
+    return 0;
+  }
+
+  return 1;
+}
+
+// Lowest energy at which some link can pass the upright position: the last
+// link upright with every other link hanging down. The potential is
+// -g sum_i (n - i) y_i with y measured up, so that is
+//   -g (1 - (n (n + 1) / 2 - 1)).
+// A chain released from rest below it can never flip.
+static double flipEnergy(size_t n) {
+  return -GRAVITY * (2.0 - n * (n + 1) / 2.0);
+}
+
+// theta = pi hangs down, so a link has flipped once its angle leaves
+// (0, 2 pi).
+static int flipped(size_t n, const float* thetas) {
+  for (size_t i = 0; i < n; i++) {
+    if (thetas[i] <= 0 || thetas[i] >= 2 * PI) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// One task per row. Each pixel stops integrating as soon as it flips.
+static void flipRow(void* context, size_t row, int worker) {
+  struct Job* job = (struct Job*)context;
+  const struct Options* options = job->options;
+  struct Workspace* ws = job->workspaces[worker];
+
+  float thetas[LINKS], omegas[LINKS];
+  float phi2 = PI - 2 * PI * (row + 0.5f) / options->height;
+
+  for (int column = 0; column < options->width; column++) {
+    float phi1 = -PI + 2 * PI * (column + 0.5f) / options->width;
+
+    thetas[0] = PI + phi1;
+    thetas[1] = PI + phi2;
+    omegas[0] = omegas[1] = 0;
+
+    float time = NO_FLIP;
+
+    if (energy(LINKS, thetas, omegas) >= flipEnergy(LINKS)) {
+      for (long step = 1; step <= job->steps; step++) {
+        rk4(ws, options->dt, thetas, omegas);
+        if (flipped(LINKS, thetas)) {
+          time = step * options->dt;
+          break;
+        }
+      }
+    }
+
+    job->times[row * options->width + column] = time;
+  }
+}
+
+// Log-scaled flip time through a cosine palette, short times bright.
+static void colour(float time, float seconds, unsigned char* rgb) {
+  if (time < 0) {
+    rgb[0] = rgb[1] = rgb[2] = 0;
+    return;
+  }
+
+  float u = logf(1.0f + time) / logf(1.0f + seconds);
+  static const float phase[3] = {0.0f, 0.33f, 0.67f};
+
+  for (int c = 0; c < 3; c++) {
+    float value = (0.5f + 0.5f * cosf(2 * PI * (0.8f * u + phase[c]))) * (1.0f - 0.7f * u);
+    rgb[c] = (unsigned char)(255.0f * value + 0.5f);
+  }
+}
+
+static int writeOutputs(const struct Options* options, const float* times) {
+  size_t pixels = (size_t)options->width * options->height;
+  size_t length = strlen(options->prefix) + 5;
+  char* path = (char*)malloc(length);
+
+  snprintf(path, length, "%s.f32", options->prefix);
+  FILE* raw = fopen(path, "wb");
+  if (raw == NULL) {
+    printf("Failed to open %s\n", path);
+    free(path);
+    return 0;
+  }
+  fwrite(times, sizeof(float), pixels, raw);
+  fclose(raw);
+
+  snprintf(path, length, "%s.ppm", options->prefix);
+  FILE* image = fopen(path, "wb");
+  if (image == NULL) {
+    printf("Failed to open %s\n", path);
+    free(path);
+    return 0;
+  }
+
+  unsigned char* rgb = (unsigned char*)malloc(pixels * 3);
+  for (size_t i = 0; i < pixels; i++) {
+    colour(times[i], options->seconds, rgb + 3 * i);
+  }
+
+  fprintf(image, "P6\n%d %d\n255\n", options->width, options->height);
+  fwrite(rgb, 3, pixels, image);
+  fclose(image);
+
+  free(rgb);
+  free(path);
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  struct Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    return 1;
+  }
+
+  struct ThreadPool* pool = createThreadPool(options.threads, 0);
+  int workers = threadPoolWorkers(pool);
+
+  struct Job job;
+  job.options = &options;
+  job.steps = (long)(options.seconds / options.dt);
+  job.times = (float*)malloc((size_t)options.width * options.height * sizeof(float));
+  job.workspaces = (struct Workspace**)malloc(workers * sizeof(struct Workspace*));
+  for (int w = 0; w < workers; w++) {
+    job.workspaces[w] = createWorkspace(LINKS, ENGINE_CHOLESKY);
+  }
+
+  double start = now();
+  parallelFor(pool, options.height, flipRow, &job);
+  double elapsed = now() - start;
+
+  long evaluations = 0;
+  for (int w = 0; w < workers; w++) {
+    evaluations += job.workspaces[w]->evaluations;
+  }
+
+  size_t pixels = (size_t)options.width * options.height;
+  size_t flips = 0;
+  for (size_t i = 0; i < pixels; i++) {
+    flips += job.times[i] >= 0;
+  }
+
+  printf("%dx%d pixels, %.4g s at dt %g, %d threads\n", options.width, options.height, options.seconds, options.dt, workers);
+  printf("flipped %zu of %zu pixels (%.1f%%)\n", flips, pixels, 100.0 * flips / pixels);
+  printf("%.3g s wall, %.3g steps/s\n", elapsed, evaluations / 4 / elapsed);
+
+  int written = writeOutputs(&options, job.times);
+
+  for (int w = 0; w < workers; w++) {
+    destroyWorkspace(job.workspaces[w]);
+  }
+  free(job.workspaces);
+  free(job.times);
+  destroyThreadPool(pool);
+  return written ? 0 : 1;
+}
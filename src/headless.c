@@ -0,0 +1,180 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "integrators.h"
+#include "physics.h"
+
+// Steps the same chain as main.c without a window or GL context, so physics
+// throughput can be measured on machines without a display.
+
+#define DEFAULT_LINKS 2
+#define DEFAULT_STEPS 100000
+
+#define PI 3.14159265358979323846f
+#define TIME_STEP 0.0166f
+
+#define DEFAULT_THETA (3 * PI / 4.0f)
+#define DEFAULT_OMEGA 0.9f
+
+// With a wall-time budget the clock is only read every this many steps.
+#define CLOCK_INTERVAL 64
+
+struct Options {
+  size_t links;
+  long steps;
+  double seconds;
+  float dt;
+  enum Engine engine;
+  enum Method method;
+};
+
+static const char* engineNames[] = {"lu", "cholesky", "aba"};
+static const char* methodNames[] = {"rk4", "dopri45", "gauss2", "gauss3", "abm4"};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int lookup(const char* name, const char** names, int count) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(name, names[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void usage(const char* program) {
+  printf("usage: %s [-n links] [-s steps | -t seconds] [-d dt] [-e lu|cholesky|aba] [-m rk4|dopri45|gauss2|gauss3|abm4]\n", program);
+}
+
+static int parseOptions(int argc, char** argv, struct Options* options) {
+  options->links = DEFAULT_LINKS;
+  options->steps = DEFAULT_STEPS;
+  options->seconds = 0;
+  options->dt = TIME_STEP;
+  options->engine = ENGINE_CHOLESKY;
+  options->method = METHOD_RK4;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+      usage(argv[0]);
+      return 0;
+    }
+
+    const char* value = argv[++i];
+    int index;
+
+    switch (argv[i - 1][1]) {
+      case 'n':
+        options->links = strtoul(value, NULL, 10);
+        break;
+      case 's':
+        options->steps = strtol(value, NULL, 10);
+        options->seconds = 0;
+        break;
+      case 't':
+        options->seconds = strtod(value, NULL);
+        break;
+      case 'd':
+        options->dt = strtof(value, NULL);
+        break;
+      case 'e':
+        index = lookup(value, engineNames, sizeof(engineNames) / sizeof(engineNames[0]));
+        if (index < 0) {
+          printf("Unknown engine: %s\n", value);
+          return 0;
+        }
+        options->engine = (enum Engine)index;
+        break;
+      case 'm':
+        index = lookup(value, methodNames, sizeof(methodNames) / sizeof(methodNames[0]));
+        if (index < 0) {
+          printf("Unknown method: %s\n", value);
+          return 0;
+        }
+        options->method = (enum Method)index;
+        break;
+      default:
+        usage(argv[0]);
+        return 0;
+    }
+  }
+
+  if (options->links == 0 || options->dt <= 0 || (options->seconds <= 0 && options->steps <= 0)) {
+    usage(argv[0]);
+    return 0;
+  }
+
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  struct Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    return 1;
+  }
+
+  size_t n = options.links;
+  struct Workspace* ws = createWorkspace(n, options.engine);
+  struct Integrator* integrator = createIntegrator(ws, options.method);
+  if (integrator == NULL) {
+    destroyWorkspace(ws);
+    return 1;
+  }
+
+  float* thetas = (float*)malloc(n * sizeof(float));
+  float* omegas = (float*)malloc(n * sizeof(float));
+  for (size_t i = 0; i < n; i++) {
+    thetas[i] = DEFAULT_THETA;
+    omegas[i] = DEFAULT_OMEGA;
+  }
+
+  double initial = energy(n, thetas, omegas);
+
+  long steps = 0;
+  int failed = 0;
+  double start = now();
+  double elapsed = 0;
+
+  if (options.seconds > 0) {
+    while (!failed && elapsed < options.seconds) {
+      for (int i = 0; i < CLOCK_INTERVAL && !failed; i++, steps++) {
+        failed = !integrate(integrator, options.dt, thetas, omegas);
+      }
+      elapsed = now() - start;
+    }
+  } else {
+    for (; !failed && steps < options.steps; steps++) {
+      failed = !integrate(integrator, options.dt, thetas, omegas);
+    }
+    elapsed = now() - start;
+  }
+
+  if (failed) {
+    printf("Integration failed at step %ld: the error estimate is not finite\n", steps);
+  }
+
+  double final = energy(n, thetas, omegas);
+
+  printf("links %zu, engine %s, method %s, dt %g\n", n, engineNames[options.engine], methodNames[options.method], options.dt);
+  printf("steps          %ld (%.4g s simulated)\n", steps, steps * (double)options.dt);
+  printf("wall time      %.4g s\n", elapsed);
+  printf("steps/s        %.4g\n", steps / elapsed);
+  printf("ns/step        %.4g\n", elapsed * 1e9 / steps);
+  printf("f() calls      %ld\n", ws->evaluations);
+  printf("energy error   %.4g (%.3g relative)\n", final - initial, fabs((final - initial) / initial));
+
+  free(omegas);
+  free(thetas);
+  destroyIntegrator(integrator);
+  destroyWorkspace(ws);
+  return failed;
+}
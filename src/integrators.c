@@ -0,0 +1,492 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "integrators.h"
+
+#define DOPRI_STAGES 7
+#define DOPRI_SAFETY 0.9f
+#define DOPRI_MIN_FACTOR 0.2f
+#define DOPRI_MAX_FACTOR 10.0f
+#define DOPRI_MIN_STEP 1e-6f
+
+// PI step-size controller exponents from Hairer & Wanner's DOPRI5:
+// h_new = h * safety * err^-(1/5 - 0.75 * beta) * err_prev^beta.
+#define DOPRI_BETA 0.04f
+#define DOPRI_ALPHA (0.2f - 0.75f * DOPRI_BETA)
+
+// Dormand-Prince tableau. Row 6 equals the fifth-order weights, so the
+// last stage is f at the new state and doubles as the next step's first
+// stage (first same as last).
+static const float dopriA[DOPRI_STAGES][DOPRI_STAGES - 1] = {
+  {0},
+  {1.0f / 5.0f},
+  {3.0f / 40.0f, 9.0f / 40.0f},
+  {44.0f / 45.0f, -56.0f / 15.0f, 32.0f / 9.0f},
+  {19372.0f / 6561.0f, -25360.0f / 2187.0f, 64448.0f / 6561.0f, -212.0f / 729.0f},
+  {9017.0f / 3168.0f, -355.0f / 33.0f, 46732.0f / 5247.0f, 49.0f / 176.0f, -5103.0f / 18656.0f},
+  {35.0f / 384.0f, 0.0f, 500.0f / 1113.0f, 125.0f / 192.0f, -2187.0f / 6784.0f, 11.0f / 84.0f},
+};
+
+// Fifth-order minus embedded fourth-order weights.
+static const float dopriE[DOPRI_STAGES] = {
+  71.0f / 57600.0f, 0.0f, -71.0f / 16695.0f, 71.0f / 1920.0f, -17253.0f / 339200.0f, 22.0f / 525.0f, -1.0f / 40.0f,
+};
+
+#define GAUSS_MAX_STAGES 3
+
+struct GaussTableau {
+  int stages;
+  float a[GAUSS_MAX_STAGES][GAUSS_MAX_STAGES];
+  float b[GAUSS_MAX_STAGES];
+};
+
+#define SQRT3 1.7320508075688772
+#define SQRT15 3.8729833462074170
+
+static const struct GaussTableau gauss2 = {
+  2,
+  {
+    {0.25f, (float)(0.25 - SQRT3 / 6.0)},
+    {(float)(0.25 + SQRT3 / 6.0), 0.25f},
+  },
+  {0.5f, 0.5f},
+};
+
+static const struct GaussTableau gauss3 = {
+  3,
+  {
+    {5.0f / 36.0f, (float)(2.0 / 9.0 - SQRT15 / 15.0), (float)(5.0 / 36.0 - SQRT15 / 30.0)},
+    {(float)(5.0 / 36.0 + SQRT15 / 24.0), 2.0f / 9.0f, (float)(5.0 / 36.0 - SQRT15 / 24.0)},
+    {(float)(5.0 / 36.0 + SQRT15 / 30.0), (float)(2.0 / 9.0 + SQRT15 / 15.0), 5.0f / 36.0f},
+  },
+  {5.0f / 18.0f, 4.0f / 9.0f, 5.0f / 18.0f},
+};
+
+struct Integrator* createIntegrator(struct Workspace* ws, enum Method method) {
+  if ((method == METHOD_GAUSS2 || method == METHOD_GAUSS3) && ws->engine == ENGINE_ABA) {
+    printf("Gauss-Legendre integrators need a dense engine for M(theta)\n");
+    return NULL;
+  }
+
+  struct Integrator* integrator = (struct Integrator*)calloc(1, sizeof(struct Integrator));
+  size_t n = ws->n;
+
+  integrator->method = method;
+  integrator->ws = ws;
+
+  if (method == METHOD_DOPRI45) {
+    integrator->atol = DOPRI_ATOL;
+    integrator->rtol = DOPRI_RTOL;
+    integrator->previousError = 1e-4f;
+
+    integrator->lastThetas = (float*)calloc(n, sizeof(float));
+    integrator->lastOmegas = (float*)calloc(n, sizeof(float));
+    integrator->stageThetas = (float*)calloc(n, sizeof(float));
+    integrator->stageOmegas = (float*)calloc(n, sizeof(float));
+
+    for (int s = 0; s < DOPRI_STAGES; s++) {
+      integrator->kThetas[s] = (float*)calloc(n, sizeof(float));
+      integrator->kOmegas[s] = (float*)calloc(n, sizeof(float));
+    }
+  }
+
+  if (method == METHOD_GAUSS2 || method == METHOD_GAUSS3) {
+    integrator->momenta = (float*)calloc(n, sizeof(float));
+    integrator->lastThetas = (float*)calloc(n, sizeof(float));
+    integrator->lastOmegas = (float*)calloc(n, sizeof(float));
+    integrator->stageThetas = (float*)calloc(n, sizeof(float));
+    integrator->stageOmegas = (float*)calloc(n, sizeof(float));
+
+    for (int s = 0; s < 2 * GAUSS_MAX_STAGES; s++) {
+      integrator->kThetas[s] = (float*)calloc(n, sizeof(float));
+      integrator->kOmegas[s] = (float*)calloc(n, sizeof(float));
+    }
+  }
+
+  if (method == METHOD_ABM4) {
+    integrator->lastThetas = (float*)calloc(n, sizeof(float));
+    integrator->lastOmegas = (float*)calloc(n, sizeof(float));
+    integrator->stageThetas = (float*)calloc(n, sizeof(float));
+    integrator->stageOmegas = (float*)calloc(n, sizeof(float));
+    integrator->kThetas[0] = (float*)calloc(n, sizeof(float));
+    integrator->kOmegas[0] = (float*)calloc(n, sizeof(float));
+
+    for (int s = 0; s < ABM_STEPS; s++) {
+      integrator->historyThetas[s] = (float*)calloc(n, sizeof(float));
+      integrator->historyOmegas[s] = (float*)calloc(n, sizeof(float));
+    }
+  }
+
+  return integrator;
+}
+
+void destroyIntegrator(struct Integrator* integrator) {
+  if (integrator == NULL) {
+    return;
+  }
+
+  for (int s = 0; s < DOPRI_STAGES; s++) {
+    free(integrator->kThetas[s]);
+    free(integrator->kOmegas[s]);
+  }
+
+  for (int s = 0; s < ABM_STEPS; s++) {
+    free(integrator->historyThetas[s]);
+    free(integrator->historyOmegas[s]);
+  }
+
+  free(integrator->momenta);
+  free(integrator->stageOmegas);
+  free(integrator->stageThetas);
+  free(integrator->lastOmegas);
+  free(integrator->lastThetas);
+
+  free(integrator);
+}
+
+// Scaled RMS of the embedded error estimate over every theta and omega.
+static float dopriError(struct Integrator* integrator, float h, const float* y0, const float* y1, float** k) {
+  size_t n = integrator->ws->n;
+  float sum = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    float e = 0;
+    for (int s = 0; s < DOPRI_STAGES; s++) {
+      e += dopriE[s] * k[s][i];
+    }
+    float scale = integrator->atol + integrator->rtol * fmaxf(fabsf(y0[i]), fabsf(y1[i]));
+    float ratio = h * e / scale;
+    sum += ratio * ratio;
+  }
+
+  return sum;
+}
+
+// Advances the state by exactly dt in as many accepted steps as the
+// tolerances require. The final step is shortened to land on dt, and such a
+// truncated step is not allowed to grow the controller's step size. Steps
+// never shrink below DOPRI_MIN_STEP, or below one ulp of dt so t keeps
+// moving; at that size a step is accepted whatever its error. Returns 0,
+// with the state at the last accepted step, if the error estimate is NaN
+// or infinite, since no step size recovers from that.
+int dopri45(struct Integrator* integrator, float dt, float* thetas, float* omegas) {
+  struct Workspace* ws = integrator->ws;
+  size_t n = ws->n;
+
+  float** kT = integrator->kThetas;
+  float** kO = integrator->kOmegas;
+  float* sT = integrator->stageThetas;
+  float* sO = integrator->stageOmegas;
+
+  // The FSAL derivative is only reusable if nobody touched the state since
+  // the last call.
+  if (!integrator->haveLast || memcmp(thetas, integrator->lastThetas, n * sizeof(float)) != 0 ||
+      memcmp(omegas, integrator->lastOmegas, n * sizeof(float)) != 0) {
+    f(ws, thetas, omegas, kT[0], kO[0]);
+  }
+
+  if (integrator->h <= 0) {
+    integrator->h = dt;
+  }
+
+  float minStep = fmaxf(DOPRI_MIN_STEP, dt * FLT_EPSILON);
+  int finished = 1;
+
+  float t = 0;
+  while (t < dt) {
+    float h = integrator->h;
+    int truncated = 0;
+    if (t + 1.01f * h >= dt) {
+      truncated = h > dt - t;
+      h = dt - t;
+    }
+
+    for (int s = 1; s < DOPRI_STAGES; s++) {
+      for (size_t i = 0; i < n; i++) {
+        float dTheta = 0, dOmega = 0;
+        for (int j = 0; j < s; j++) {
+          dTheta += dopriA[s][j] * kT[j][i];
+          dOmega += dopriA[s][j] * kO[j][i];
+        }
+        sT[i] = thetas[i] + h * dTheta;
+        sO[i] = omegas[i] + h * dOmega;
+      }
+      f(ws, sT, sO, kT[s], kO[s]);
+    }
+
+    // After the loop the stage buffers hold the fifth-order solution.
+    float sum = dopriError(integrator, h, thetas, sT, kT) + dopriError(integrator, h, omegas, sO, kO);
+    float error = sqrtf(sum / (2 * n));
+
+    if (!isfinite(error)) {
+      integrator->rejected++;
+      finished = 0;
+      break;
+    }
+
+    if (error <= 1.0f || h <= minStep) {
+      float factor = DOPRI_SAFETY * powf(error, -DOPRI_ALPHA) * powf(integrator->previousError, DOPRI_BETA);
+      factor = fminf(DOPRI_MAX_FACTOR, fmaxf(DOPRI_MIN_FACTOR, factor));
+
+      integrator->h = fmaxf(minStep, truncated ? integrator->h * fminf(factor, 1.0f) : h * factor);
+      integrator->previousError = fmaxf(error, 1e-4f);
+      integrator->accepted++;
+
+      memcpy(thetas, sT, n * sizeof(float));
+      memcpy(omegas, sO, n * sizeof(float));
+
+      float* swap = kT[0]; kT[0] = kT[6]; kT[6] = swap;
+      swap = kO[0]; kO[0] = kO[6]; kO[6] = swap;
+
+      t = h == dt - t ? dt : t + h;
+    } else {
+      float factor = fmaxf(DOPRI_MIN_FACTOR, DOPRI_SAFETY * powf(error, -0.2f));
+      integrator->h = fmaxf(minStep, h * factor);
+      integrator->rejected++;
+    }
+  }
+
+  memcpy(integrator->lastThetas, thetas, n * sizeof(float));
+  memcpy(integrator->lastOmegas, omegas, n * sizeof(float));
+  integrator->haveLast = 1;
+
+  return finished;
+}
+
+// Solves the stage equations
+//   K_i = g(y + dt * sum_j a_ij K_j),  g = hamiltonianField,
+// by fixed-point iteration from the guess already in kThetas/kOmegas, and
+// on success advances (thetas, p) by dt. Fixed-point needs no Jacobian of
+// g and converges in a handful of sweeps while dt stays below the local
+// time scale. Each sweep costs one mass-matrix assembly and factorisation
+// per stage. Returns 0 and leaves the state alone if the iteration stalls
+// or diverges, which happens during fast whips at large dt.
+static int collocate(struct Integrator* integrator, const struct GaussTableau* tableau, float dt, float* thetas, float* p, int force) {
+  struct Workspace* ws = integrator->ws;
+  size_t n = ws->n;
+  int stages = tableau->stages;
+
+  float** kT = integrator->kThetas;
+  float** kP = integrator->kOmegas;
+  float** nextT = integrator->kThetas + GAUSS_MAX_STAGES;
+  float** nextP = integrator->kOmegas + GAUSS_MAX_STAGES;
+  float* zT = integrator->stageThetas;
+  float* zP = integrator->stageOmegas;
+
+  float previousChange = INFINITY;
+  int converged = 0;
+
+  for (int iteration = 0; iteration < GAUSS_MAX_ITERATIONS; iteration++) {
+    float change = 0;
+
+    for (int i = 0; i < stages; i++) {
+      for (size_t m = 0; m < n; m++) {
+        float dTheta = 0, dMomentum = 0;
+        for (int j = 0; j < stages; j++) {
+          dTheta += tableau->a[i][j] * kT[j][m];
+          dMomentum += tableau->a[i][j] * kP[j][m];
+        }
+        zT[m] = thetas[m] + dt * dTheta;
+        zP[m] = p[m] + dt * dMomentum;
+      }
+
+      hamiltonianField(ws, zT, zP, nextT[i], nextP[i]);
+
+      for (size_t m = 0; m < n; m++) {
+        change = fmaxf(change, fabsf(nextT[i][m] - kT[i][m]) * dt / (1.0f + fabsf(thetas[m])));
+        change = fmaxf(change, fabsf(nextP[i][m] - kP[i][m]) * dt / (1.0f + fabsf(p[m])));
+      }
+    }
+
+    for (int i = 0; i < stages; i++) {
+      float* swap = kT[i]; kT[i] = nextT[i]; nextT[i] = swap;
+      swap = kP[i]; kP[i] = nextP[i]; nextP[i] = swap;
+    }
+
+    integrator->iterations++;
+    if (change < GAUSS_TOLERANCE) {
+      converged = 1;
+      break;
+    }
+
+    // A contraction shrinks the update every sweep; anything else will not
+    // reach the tolerance.
+    if (!(change < previousChange) && iteration >= 2) {
+      break;
+    }
+    previousChange = change;
+  }
+
+  if (!converged && !force) {
+    return 0;
+  }
+
+  for (size_t m = 0; m < n; m++) {
+    float dTheta = 0, dMomentum = 0;
+    for (int i = 0; i < stages; i++) {
+      dTheta += tableau->b[i] * kT[i][m];
+      dMomentum += tableau->b[i] * kP[i][m];
+    }
+    thetas[m] += dt * dTheta;
+    p[m] += dt * dMomentum;
+  }
+
+  return 1;
+}
+
+// Advances by dt, halving the step wherever the stage equations fail to
+// converge. Splits are rare and local, so the long-run energy behaviour is
+// still that of the fixed-step method.
+static void gaussAdvance(struct Integrator* integrator, const struct GaussTableau* tableau, float dt, float* thetas, float* p, int depth) {
+  struct Workspace* ws = integrator->ws;
+  size_t n = ws->n;
+
+  if (!integrator->haveStages) {
+    float** kT = integrator->kThetas;
+    float** kP = integrator->kOmegas;
+
+    hamiltonianField(ws, thetas, p, kT[0], kP[0]);
+    for (int i = 1; i < tableau->stages; i++) {
+      memcpy(kT[i], kT[0], n * sizeof(float));
+      memcpy(kP[i], kP[0], n * sizeof(float));
+    }
+    integrator->haveStages = 1;
+  }
+
+  if (collocate(integrator, tableau, dt, thetas, p, depth >= GAUSS_MAX_SPLITS)) {
+    return;
+  }
+
+  integrator->haveStages = 0;
+  integrator->splits++;
+  gaussAdvance(integrator, tableau, dt / 2.0f, thetas, p, depth + 1);
+  gaussAdvance(integrator, tableau, dt / 2.0f, thetas, p, depth + 1);
+}
+
+// One Gauss-Legendre step of size dt (more only where it has to split).
+// The previous step's stage derivatives seed the next solve.
+void gaussLegendre(struct Integrator* integrator, float dt, float* thetas, float* omegas) {
+  struct Workspace* ws = integrator->ws;
+  size_t n = ws->n;
+
+  const struct GaussTableau* tableau = integrator->method == METHOD_GAUSS3 ? &gauss3 : &gauss2;
+  float* p = integrator->momenta;
+
+  // Keep integrating in momentum form while the caller hands back the
+  // state we returned; otherwise start afresh from the given velocities.
+  if (!integrator->haveLast || memcmp(thetas, integrator->lastThetas, n * sizeof(float)) != 0 ||
+      memcmp(omegas, integrator->lastOmegas, n * sizeof(float)) != 0) {
+    generalizedMomenta(ws, thetas, omegas, p);
+    integrator->haveStages = 0;
+  }
+
+  gaussAdvance(integrator, tableau, dt, thetas, p, 0);
+
+  // Recovering omega costs a factorisation just like an evaluation.
+  generalizedVelocities(ws, thetas, p, omegas);
+  ws->evaluations++;
+
+  memcpy(integrator->lastThetas, thetas, n * sizeof(float));
+  memcpy(integrator->lastOmegas, omegas, n * sizeof(float));
+  integrator->haveLast = 1;
+}
+
+// Makes (thetas, omegas) the newest entry of the derivative history.
+static void pushHistory(struct Integrator* integrator, const float* thetas, const float* omegas) {
+  integrator->historyHead = (integrator->historyHead + 1) % ABM_STEPS;
+  f(integrator->ws, thetas, omegas, integrator->historyThetas[integrator->historyHead],
+    integrator->historyOmegas[integrator->historyHead]);
+  if (integrator->historyCount < ABM_STEPS) {
+    integrator->historyCount++;
+  }
+}
+
+// f() at the state `back` steps before the newest one.
+#define HISTORY(ring, back) (ring)[(integrator->historyHead + ABM_STEPS - (back)) % ABM_STEPS]
+
+// One step of the fourth-order Adams-Bashforth predictor and Adams-Moulton
+// corrector, evaluating f() at the prediction and again at the corrected
+// state (PECE). The history only describes an equally spaced trajectory
+// ending at the current state, so it is dropped whenever dt changes or the
+// caller edits the state, and rebuilt with ABM_STEPS - 1 rk4 steps.
+void adamsBashforthMoulton(struct Integrator* integrator, float dt, float* thetas, float* omegas) {
+  struct Workspace* ws = integrator->ws;
+  size_t n = ws->n;
+
+  if (!integrator->haveLast || dt != integrator->historyStep ||
+      memcmp(thetas, integrator->lastThetas, n * sizeof(float)) != 0 ||
+      memcmp(omegas, integrator->lastOmegas, n * sizeof(float)) != 0) {
+    if (integrator->historyCount > 0) {
+      integrator->restarts++;
+    }
+    integrator->historyCount = 0;
+    integrator->historyStep = dt;
+  }
+
+  if (integrator->historyCount < ABM_STEPS - 1) {
+    // rk4 computes f() at the current state as its first stage; keep it.
+    rk4(ws, dt, thetas, omegas);
+    integrator->historyHead = (integrator->historyHead + 1) % ABM_STEPS;
+    memcpy(integrator->historyThetas[integrator->historyHead], ws->kThetas[0], n * sizeof(float));
+    memcpy(integrator->historyOmegas[integrator->historyHead], ws->kOmegas[0], n * sizeof(float));
+    integrator->historyCount++;
+  } else {
+    if (integrator->historyCount < ABM_STEPS) {
+      pushHistory(integrator, thetas, omegas);
+    }
+
+    float* sT = integrator->stageThetas;
+    float* sO = integrator->stageOmegas;
+    float* pT = integrator->kThetas[0];
+    float* pO = integrator->kOmegas[0];
+
+    float* t0 = HISTORY(integrator->historyThetas, 0);
+    float* t1 = HISTORY(integrator->historyThetas, 1);
+    float* t2 = HISTORY(integrator->historyThetas, 2);
+    float* t3 = HISTORY(integrator->historyThetas, 3);
+    float* o0 = HISTORY(integrator->historyOmegas, 0);
+    float* o1 = HISTORY(integrator->historyOmegas, 1);
+    float* o2 = HISTORY(integrator->historyOmegas, 2);
+    float* o3 = HISTORY(integrator->historyOmegas, 3);
+
+    for (size_t i = 0; i < n; i++) {
+      sT[i] = thetas[i] + (dt / 24.0f) * (55.0f * t0[i] - 59.0f * t1[i] + 37.0f * t2[i] - 9.0f * t3[i]);
+      sO[i] = omegas[i] + (dt / 24.0f) * (55.0f * o0[i] - 59.0f * o1[i] + 37.0f * o2[i] - 9.0f * o3[i]);
+    }
+    f(ws, sT, sO, pT, pO);
+
+    for (size_t i = 0; i < n; i++) {
+      thetas[i] += (dt / 24.0f) * (9.0f * pT[i] + 19.0f * t0[i] - 5.0f * t1[i] + t2[i]);
+      omegas[i] += (dt / 24.0f) * (9.0f * pO[i] + 19.0f * o0[i] - 5.0f * o1[i] + o2[i]);
+    }
+
+    // Overwrites the oldest entry, which this step was the last to need.
+    pushHistory(integrator, thetas, omegas);
+  }
+
+  memcpy(integrator->lastThetas, thetas, n * sizeof(float));
+  memcpy(integrator->lastOmegas, omegas, n * sizeof(float));
+  integrator->haveLast = 1;
+}
+
+int integrate(struct Integrator* integrator, float dt, float* thetas, float* omegas) {
+  switch (integrator->method) {
+    case METHOD_DOPRI45:
+      return dopri45(integrator, dt, thetas, omegas);
+    case METHOD_GAUSS2:
+    case METHOD_GAUSS3:
+      gaussLegendre(integrator, dt, thetas, omegas);
+      break;
+    case METHOD_ABM4:
+      adamsBashforthMoulton(integrator, dt, thetas, omegas);
+      break;
+    case METHOD_RK4:
+    default:
+      rk4(integrator->ws, dt, thetas, omegas);
+      break;
+  }
+  return 1;
+}
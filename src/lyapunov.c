@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lyapunov.h"
+
+// Weighted sums per tangent vector: W (c o x) and W (s o x) for three x.
+#define WEIGHTED_TERMS 6
+
+struct Lyapunov* createLyapunov(struct Workspace* ws, int count) {
+  if (ws->engine == ENGINE_ABA) {
+    printf("Lyapunov exponents need a dense engine for M(theta)\n");
+    return NULL;
+  }
+
+  size_t n = ws->n;
+  if (count < 1 || count > (int)(2 * n)) {
+    printf("Lyapunov count must be between 1 and %zu\n", 2 * n);
+    return NULL;
+  }
+
+  struct Lyapunov* lyapunov = (struct Lyapunov*)calloc(1, sizeof(struct Lyapunov));
+  lyapunov->ws = ws;
+  lyapunov->n = n;
+  lyapunov->count = count;
+  lyapunov->interval = LYAPUNOV_RENORMALIZE_STEPS;
+
+  size_t size = count * 2 * n;
+  lyapunov->tangents = (float*)calloc(size, sizeof(float));
+  lyapunov->stageTangents = (float*)calloc(size, sizeof(float));
+  for (int s = 0; s < 4; s++) {
+    lyapunov->kTangents[s] = (float*)calloc(size, sizeof(float));
+  }
+  lyapunov->sums = (double*)calloc(count, sizeof(double));
+
+  lyapunov->alphas = (float*)calloc(n, sizeof(float));
+  lyapunov->omegaSumC = (float*)calloc(n, sizeof(float));
+  lyapunov->omegaSumS = (float*)calloc(n, sizeof(float));
+  lyapunov->alphaSumC = (float*)calloc(n, sizeof(float));
+  lyapunov->alphaSumS = (float*)calloc(n, sizeof(float));
+  lyapunov->rhs = (float*)calloc(n, sizeof(float));
+  lyapunov->products = (float*)calloc(2 * WEIGHTED_TERMS * n, sizeof(float));
+
+  // Start from the first `count` unit vectors, already orthonormal.
+  for (int v = 0; v < count; v++) {
+    lyapunov->tangents[v * 2 * n + v] = 1.0f;
+  }
+
+  return lyapunov;
+}
+
+void destroyLyapunov(struct Lyapunov* lyapunov) {
+  if (lyapunov == NULL) {
+    return;
+  }
+
+  free(lyapunov->products);
+  free(lyapunov->rhs);
+  free(lyapunov->alphaSumS);
+  free(lyapunov->alphaSumC);
+  free(lyapunov->omegaSumS);
+  free(lyapunov->omegaSumC);
+  free(lyapunov->alphas);
+
+  free(lyapunov->sums);
+  for (int s = 0; s < 4; s++) {
+    free(lyapunov->kTangents[s]);
+  }
+  free(lyapunov->stageTangents);
+  free(lyapunov->tangents);
+
+  free(lyapunov);
+}
+
+// Factors the freshly assembled ws->A with the engine's method and solves
+// for alpha.
+static void factorAndSolve(struct Workspace* ws, float* alphas) {
+  size_t n = ws->n;
+
+  if (ws->engine == ENGINE_CHOLESKY) {
+    solveSymmetricSystem(ws, ws->A, ws->B, alphas);
+  } else {
+    lu_decompose(n, ws->A, ws->L, ws->U);
+    forward_substitution(n, ws->L, ws->B, ws->y);
+    backward_substitution(n, ws->U, ws->y, alphas);
+  }
+}
+
+// Solves M x = rhs against the factorisation factorAndSolve() left behind.
+static void solveFactored(struct Workspace* ws, const float* rhs, float* x) {
+  size_t n = ws->n;
+
+  if (ws->engine == ENGINE_CHOLESKY) {
+    memcpy(x, rhs, n * sizeof(float));
+    ldlt_substitution(n, ws->A, x);
+  } else {
+    forward_substitution(n, ws->L, rhs, ws->y);
+    backward_substitution(n, ws->U, ws->y, x);
+  }
+}
+
+// out = W x for the chain's weights W_ij = mu_max(i, j) l_i l_j, in O(n):
+//   (W x)_i = l_i (mu_i sum_{j <= i} l_j x_j + sum_{j > i} mu_j l_j x_j).
+static void weightedSum(const struct Workspace* ws, const float* x, float* out) {
+  size_t n = ws->n;
+  const float* mu = ws->suffixMasses;
+  const float* moments = ws->suffixMoments;
+  const float* lengths = ws->lengths;
+
+  float suffix = 0;
+  for (size_t i = n; i-- > 0;) {
+    out[i] = suffix;
+    suffix += moments[i] * x[i];
+  }
+
+  float prefix = 0;
+  for (size_t i = 0; i < n; i++) {
+    prefix += lengths[i] * x[i];
+    out[i] = lengths[i] * (out[i] + mu[i] * prefix);
+  }
+}
+
+// f() together with its directional derivative along each tangent vector.
+// With s, c the per-angle sines and cosines, every pairwise sum splits as
+//   sum_j W_ij sin(ti - tj) x_j = si (W (c o x))_i - ci (W (s o x))_i
+//   sum_j W_ij cos(ti - tj) x_j = ci (W (c o x))_i + si (W (s o x))_i,
+// written S_i(x) and C_i(x) below. Differentiating M alpha = B then gives
+//   (dB - dM alpha)_i = -S_i(2 w o dw) - dti C_i(w^2) + C_i(w^2 o dt)
+//                       - mu_i l_i g ci dti + dti S_i(alpha) - S_i(alpha o dt).
+// The W products are O(n) each, so past the shared factorisation a tangent
+// vector costs one O(n^2) solve. Counts as one evaluation, like f().
+void tangentField(struct Lyapunov* lyapunov, const float* thetas, const float* omegas, const float* tangents,
+                  float* dThetas, float* dOmegas, float* dTangents) {
+  struct Workspace* ws = lyapunov->ws;
+  size_t n = ws->n;
+  ws->evaluations++;
+
+  float* alphas = lyapunov->alphas;
+  float* rhs = lyapunov->rhs;
+  float* in = lyapunov->products;
+  float* sum = lyapunov->products + WEIGHTED_TERMS * n;
+
+  assembleSystem(ws, thetas, omegas);
+  factorAndSolve(ws, alphas);
+
+  const float* s = ws->sines;
+  const float* c = ws->cosines;
+
+  // Terms shared by every tangent: W (c o w^2), W (s o w^2), W (c o alpha)
+  // and W (s o alpha).
+  float* omegaC = lyapunov->omegaSumC;
+  float* omegaS = lyapunov->omegaSumS;
+  float* alphaC = lyapunov->alphaSumC;
+  float* alphaS = lyapunov->alphaSumS;
+
+  for (size_t j = 0; j < n; j++) {
+    in[j] = alphas[j] * c[j];
+    in[n + j] = alphas[j] * s[j];
+  }
+  weightedSum(ws, ws->weightedCosines, omegaC);
+  weightedSum(ws, ws->weightedSines, omegaS);
+  weightedSum(ws, in, alphaC);
+  weightedSum(ws, in + n, alphaS);
+
+  for (int v = 0; v < lyapunov->count; v++) {
+    const float* dTheta = tangents + v * 2 * n;
+    const float* dOmega = dTheta + n;
+    float* out = dTangents + v * 2 * n;
+
+    for (size_t j = 0; j < n; j++) {
+      float rate = 2.0f * omegas[j] * dOmega[j];
+      float angle = omegas[j] * omegas[j] * dTheta[j];
+      float accel = alphas[j] * dTheta[j];
+      in[j] = rate * c[j];
+      in[n + j] = rate * s[j];
+      in[2 * n + j] = angle * c[j];
+      in[3 * n + j] = angle * s[j];
+      in[4 * n + j] = accel * c[j];
+      in[5 * n + j] = accel * s[j];
+    }
+    for (int t = 0; t < WEIGHTED_TERMS; t++) {
+      weightedSum(ws, in + t * n, sum + t * n);
+    }
+
+    const float* rateC = sum;
+    const float* rateS = sum + n;
+    const float* angleC = sum + 2 * n;
+    const float* angleS = sum + 3 * n;
+    const float* accelC = sum + 4 * n;
+    const float* accelS = sum + 5 * n;
+
+    for (size_t i = 0; i < n; i++) {
+      float si = s[i], ci = c[i];
+      rhs[i] = -(si * rateC[i] - ci * rateS[i]) - dTheta[i] * (ci * omegaC[i] + si * omegaS[i])
+             + (ci * angleC[i] + si * angleS[i]) - ws->suffixMoments[i] * GRAVITY * ci * dTheta[i]
+             + dTheta[i] * (si * alphaC[i] - ci * alphaS[i]) - (si * accelC[i] - ci * accelS[i]);
+    }
+
+    memcpy(out, dOmega, n * sizeof(float));
+    solveFactored(ws, rhs, out + n);
+  }
+
+  memcpy(dOmegas, alphas, n * sizeof(float));
+  memcpy(dThetas, omegas, n * sizeof(float));
+}
+
+// rk4() on the state and tangents together, re-orthonormalising every
+// `interval` steps.
+void lyapunovStep(struct Lyapunov* lyapunov, float dt, float* thetas, float* omegas) {
+  struct Workspace* ws = lyapunov->ws;
+  size_t n = ws->n;
+  size_t size = lyapunov->count * 2 * n;
+
+  float** kT = ws->kThetas;
+  float** kO = ws->kOmegas;
+  float** kV = lyapunov->kTangents;
+  float* sT = ws->stageThetas;
+  float* sO = ws->stageOmegas;
+  float* sV = lyapunov->stageTangents;
+  float* V = lyapunov->tangents;
+
+  static const float stageScale[4] = {0.0f, 0.5f, 0.5f, 1.0f};
+
+  tangentField(lyapunov, thetas, omegas, V, kT[0], kO[0], kV[0]);
+
+  for (int stage = 1; stage < 4; stage++) {
+    float h = stageScale[stage] * dt;
+    for (size_t i = 0; i < n; i++) {
+      sT[i] = thetas[i] + h * kT[stage - 1][i];
+      sO[i] = omegas[i] + h * kO[stage - 1][i];
+    }
+    for (size_t i = 0; i < size; i++) {
+      sV[i] = V[i] + h * kV[stage - 1][i];
+    }
+    tangentField(lyapunov, sT, sO, sV, kT[stage], kO[stage], kV[stage]);
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    thetas[i] += (kT[0][i] + 2.0f * kT[1][i] + 2.0f * kT[2][i] + kT[3][i]) * (dt / 6.0f);
+    omegas[i] += (kO[0][i] + 2.0f * kO[1][i] + 2.0f * kO[2][i] + kO[3][i]) * (dt / 6.0f);
+  }
+  for (size_t i = 0; i < size; i++) {
+    V[i] += (kV[0][i] + 2.0f * kV[1][i] + 2.0f * kV[2][i] + kV[3][i]) * (dt / 6.0f);
+  }
+
+  lyapunov->steps++;
+  lyapunov->pending += dt;
+
+  if (lyapunov->steps % lyapunov->interval == 0) {
+    orthonormalize(lyapunov);
+  }
+}
+
+// Modified Gram-Schmidt, i.e. the Q of a QR factorisation of the tangents
+// with the log of R's diagonal added to the running sums.
+void orthonormalize(struct Lyapunov* lyapunov) {
+  size_t length = 2 * lyapunov->n;
+
+  for (int v = 0; v < lyapunov->count; v++) {
+    float* vector = lyapunov->tangents + v * length;
+
+    for (int u = 0; u < v; u++) {
+      const float* basis = lyapunov->tangents + u * length;
+      double dot = 0;
+      for (size_t i = 0; i < length; i++) {
+        dot += (double)vector[i] * basis[i];
+      }
+      for (size_t i = 0; i < length; i++) {
+        vector[i] -= (float)dot * basis[i];
+      }
+    }
+
+    double norm = 0;
+    for (size_t i = 0; i < length; i++) {
+      norm += (double)vector[i] * vector[i];
+    }
+    norm = sqrt(norm);
+
+    lyapunov->sums[v] += log(norm);
+    for (size_t i = 0; i < length; i++) {
+      vector[i] = (float)(vector[i] / norm);
+    }
+  }
+
+  lyapunov->time += lyapunov->pending;
+  lyapunov->pending = 0;
+}
+
+// Averages over the time covered by completed orthonormalisations.
+void lyapunovExponents(const struct Lyapunov* lyapunov, double* exponents) {
+  for (int v = 0; v < lyapunov->count; v++) {
+    exponents[v] = lyapunov->time > 0 ? lyapunov->sums[v] / lyapunov->time : 0;
+  }
+}
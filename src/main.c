@@ -5,36 +5,63 @@
 #include <string.h>
 #include <math.h>
 
-#include "shaders/shader.frag.h"
-#include "shaders/shader.vert.h"
+#include "physics.h"
+#include "integrators.h"
+#include "capture.h"
+#include "pacing.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "simulation.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 800
 
-#define VERTEX_FLOATS 3
-
-#define TRIANGLE_VERTICES 3
-#define RECTANGLE_VERTICES 4
-#define RECTANGLE_TRIANGLES 2
-
-#define INDICES_PER_QUAD 6
-
 #define ANCHOR_X 0.0f
 #define ANCHOR_Y 0.5f
 
-#define ROD_WIDTH 0.0075f
 #define BOB_RADIUS 0.05f
 
-#define GRAVITY -9.81f
+// PACING_VSYNC, PACING_DEADLINE at TARGET_FPS, or PACING_UNCAPPED; see
+// pacing.h. The title shows the frame rate, frame-time jitter and CPU load
+// every REPORT_INTERVAL seconds.
+#define FRAME_PACING PACING_VSYNC
+#define TARGET_FPS 60
+#define REPORT_INTERVAL 0.5
+
+// Frames of tip history drawn behind the last bob.
+#define TRAIL_LENGTH 2048
+
+// Set to a path to record every frame: "run.y4m" for one Y4M stream,
+// "frame%05d.ppm" for numbered PPMs. NULL draws to the window directly.
+#define CAPTURE_PATH NULL
+#define CAPTURE_FPS 60
+
+// Where a PROFILE build writes its timings on exit: a CSV summary, or a
+// Chrome trace for a name ending in ".json".
+#define PROFILE_PATH "profile.csv"
+
 #define PI 3.14159265358979323846f
-#define TIME_STEP 0.0166f
+
+// Physics steps per second of wall time, independent of the frame rate;
+// 1000-10000 keeps rk4 well inside its accurate range for six links. At
+// most MAX_SUBSTEPS steps are run to catch up after a stall.
+#define PHYSICS_RATE 2000
+#define TIME_STEP (1.0f / PHYSICS_RATE)
+#define MAX_SUBSTEPS 256
+
+// ENGINE_ABA scales to long "rope" chains, ENGINE_CHOLESKY is the fastest
+// dense path and ENGINE_LU is the reference.
+#define PHYSICS_ENGINE ENGINE_LU
+
+// METHOD_DOPRI45 subdivides each frame adaptively to DOPRI_ATOL/DOPRI_RTOL;
+// METHOD_ABM4 halves the f() calls per frame once it has four frames of
+// history.
+#define INTEGRATOR METHOD_RK4
 
 #define DEFAULT_THETA (3 * PI / 4.0f)
 #define DEFAULT_OMEGA 0.9f
 
 struct Bob {
-  float centerX;
-  float centerY;
   float radius;
 
   struct {
@@ -43,296 +70,15 @@ struct Bob {
     float b;
   } color;
 
+  // Initial conditions only; the simulation owns the state once it starts.
   float theta;
   float omega;
 
   float mass;
+  float length;
 };
 
-GLfloat* bobVertices(struct Bob* bob) {
-  GLfloat* vertices = (GLfloat*)malloc(RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(GLfloat));
-
-  float centerX = bob->centerX;
-  float centerY = bob->centerY;
-  float radius = bob->radius;
-
-  vertices[0] = centerX + radius; vertices[1] = centerY + radius; vertices[2] = 0.0f;
-  vertices[3] = centerX - radius; vertices[4] = centerY + radius; vertices[5] = 0.0f;
-  vertices[6] = centerX + radius; vertices[7] = centerY - radius; vertices[8] = 0.0f;
-  vertices[9] = centerX - radius; vertices[10] = centerY - radius; vertices[11] = 0.0f;
-
-  return vertices;
-}
-
-GLfloat* rodVertices(float centerX1, float centerY1, float centerX2, float centerY2, float rodWidth) {
-  GLfloat* vertices = (GLfloat*)malloc(RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(GLfloat));
-
-  float dx = centerX2 - centerX1;
-  float dy = centerY2 - centerY1;
-
-  double s = sqrt(dx * dx + dy * dy);
-
-  float offsetX = -(rodWidth / 2.0f) * (dy / s);
-  float offsetY = (rodWidth / 2.0f) * (dx / s);
-
-  vertices[0] = centerX1 + offsetX; vertices[1] = centerY1 + offsetY; vertices[2] = 0.0f;
-  vertices[3] = centerX1 - offsetX; vertices[4] = centerY1 - offsetY; vertices[5] = 0.0f;
-  vertices[6] = centerX2 + offsetX; vertices[7] = centerY2 + offsetY; vertices[8] = 0.0f;
-  vertices[9] = centerX2 - offsetX; vertices[10] = centerY2 - offsetY; vertices[11] = 0.0f;
-
-  return vertices;
-}
-
-GLfloat* createMatrixA(size_t n, float* thetas) {
-  GLfloat* matrixA = (GLfloat*)malloc(n * n * sizeof(GLfloat));
-
-  for (int i = 0; i < n; i++) {
-    for (int j = 0; j < n; j++) {
-      float value = (n - fmax(i, j)) * cos(thetas[i] - thetas[j]);
-      matrixA[i * n + j] = value;
-    }
-  }
-
-  return matrixA;
-}
-
-GLfloat* createVectorB(size_t n, float* thetas, float* omegas) {
-  GLfloat* vectorB = (GLfloat*)malloc(n * sizeof(GLfloat));
-
-  for (int i = 0; i < n; i++) {
-    float b_i = 0;
-    for (int j = 0; j < n; j++) {
-      b_i -= (n - fmax(i, j)) * omegas[j] * omegas[j] * sin(thetas[i] - thetas[j]);
-    }
-    b_i -= (n - i) * GRAVITY * sin(thetas[i]);
-
-    vectorB[i] = b_i;
-  }
-
-  return vectorB;
-}
-
-GLfloat** lu_decompose(size_t n, GLfloat* A) {
-  float* L = (GLfloat*)malloc(n * n * sizeof(GLfloat));
-  for (int i = 0; i < n * n; i++) {
-    L[i] = 0;
-  }
-
-  float* U = (GLfloat*)malloc(n * n * sizeof(GLfloat));
-  for (int i = 0; i < n * n; i++) {
-    U[i] = 0;
-  }
-
-  for (int i = 0; i < n; i++) {
-    for (int k = i; k < n; k++) {
-      float sum = 0;
-      for (int j = 0; j < i; j++) {
-        sum += L[i * n + j] * U[j * n + k];
-      }
-      U[i * n + k] = A[i * n + k] - sum;
-    }
-
-    for (int k = i; k < n; k++) {
-      if (i == k) {
-        L[i * n + i] = 1;
-      } else {
-        float sum = 0;
-        for (int j = 0; j < i; j++) {
-          sum += L[k * n + j] * U[j * n + i];
-        }
-        L[k * n + i] = (A[k * n + i] - sum) / U[i * n + i];
-      }
-    }
-  }
-
-  GLfloat** LU = (GLfloat**)malloc(2 * sizeof(GLfloat*));
-  LU[0] = L;
-  LU[1] = U;
-
-  return LU;
-}
-
-GLfloat* forward_substitution(size_t n, GLfloat* L, GLfloat* B) {
-  GLfloat* y = (GLfloat*)malloc(n * sizeof(GLfloat));
-  for (int i = 0; i < n; i++) {
-    y[i] = 0;
-  }
-
-  for (int i = 0; i < n; i++) {
-    float sum = 0;
-    for (int j = 0; j < i; j++) {
-      sum += L[i * n + j] * y[j];
-    }
-    y[i] = B[i] - sum;
-  }
-
-  return y;
-}
-
-GLfloat* backward_substitution(size_t n, GLfloat* U, GLfloat* y) {
-  GLfloat* x = (GLfloat*)malloc(n * sizeof(GLfloat));
-  for (int i = 0; i < n; i++) {
-    x[i] = 0;
-  }
-
-  for (int i = n - 1; i >= 0; i--) {
-    float sum = 0;
-    for (int j = i + 1; j < n; j++) {
-      sum += U[i * n + j] * x[j];
-    }
-    x[i] = (y[i] - sum) / U[i * n + i];
-  }
-
-  return x;
-}
-
-GLfloat* solveLinearSystem(size_t n, GLfloat* A, GLfloat* B) {
-  GLfloat* result = (GLfloat*)malloc(n * sizeof(GLfloat));
-
-  GLfloat** LU = lu_decompose(n, A);
-  GLfloat* L = LU[0];
-  GLfloat* U = LU[1];
-
-  GLfloat* y = forward_substitution(n, L, B);
-  GLfloat* x = backward_substitution(n, U, y);
-
-  memcpy(result, x, n * sizeof(GLfloat));
-
-  free(x);
-  free(y);
-  free(L);
-  free(U);
-  free(LU);
-
-  return result;
-}
-
-GLfloat** f(size_t n, GLfloat* thetas, GLfloat* omegas) {
-  GLfloat* A = createMatrixA(n, thetas);
-  GLfloat* B = createVectorB(n, thetas, omegas);
-
-  GLfloat* alphas = solveLinearSystem(n, A, B);
-
-  free(A);
-  free(B);
-
-  GLfloat** result = (GLfloat**)malloc(2 * sizeof(GLfloat*));
-  result[0] = (GLfloat*)malloc(n * sizeof(GLfloat));
-  result[1] = (GLfloat*)malloc(n * sizeof(GLfloat));
-
-  memcpy(result[0], omegas, n * sizeof(GLfloat));
-  memcpy(result[1], alphas, n * sizeof(GLfloat));
-
-  free(alphas);
-
-  return result;
-}
-
-GLfloat** rk4(float dt, size_t n, GLfloat* thetas, GLfloat* omegas) {
-  GLfloat** k1 = f(n, thetas, omegas);
-
-  GLfloat* k2_A = (GLfloat*)malloc(n * sizeof(GLfloat));
-  GLfloat* k2_B = (GLfloat*)malloc(n * sizeof(GLfloat));
-  for (int i = 0; i < n; i++) {
-    k2_A[i] = thetas[i] + (dt / 2.0f) * k1[0][i];
-    k2_B[i] = omegas[i] + (dt / 2.0f) * k1[1][i];
-  }
-
-  GLfloat** k2 = f(n, k2_A, k2_B);
-  free(k2_A);
-  free(k2_B);
-
-  GLfloat* k3_A = (GLfloat*)malloc(n * sizeof(GLfloat));
-  GLfloat* k3_B = (GLfloat*)malloc(n * sizeof(GLfloat));
-  for (int i = 0; i < n; i++) {
-    k3_A[i] = thetas[i] + (dt / 2.0f) * k2[0][i];
-    k3_B[i] = omegas[i] + (dt / 2.0f) * k2[1][i];
-  }
-
-  GLfloat** k3 = f(n, k3_A, k3_B);
-  free(k3_A);
-  free(k3_B);
-
-  GLfloat* k4_A = (GLfloat*)malloc(n * sizeof(GLfloat));
-  GLfloat* k4_B = (GLfloat*)malloc(n * sizeof(GLfloat));
-  for (int i = 0; i < n; i++) {
-    k4_A[i] = thetas[i] + dt * k3[0][i];
-    k4_B[i] = omegas[i] + dt * k3[1][i];
-  }
-
-  GLfloat** k4 = f(n, k4_A, k4_B);
-  free(k4_A);
-  free(k4_B);
-
-  GLfloat* thetaDeltas = (GLfloat*)malloc(n * sizeof(GLfloat));
-  GLfloat* omegaDeltas = (GLfloat*)malloc(n * sizeof(GLfloat));
-
-  for (int i = 0; i < n; i++) {
-    thetaDeltas[i] = (k1[0][i] + 2.0f * k2[0][i] + 2.0f * k3[0][i] + k4[0][i]) * (dt / 6.0f);
-    omegaDeltas[i] = (k1[1][i] + 2.0f * k2[1][i] + 2.0f * k3[1][i] + k4[1][i]) * (dt / 6.0f);
-  }
-
-  free(k1[0]);
-  free(k1[1]);
-  free(k1);
-  free(k2[0]);
-  free(k2[1]);
-  free(k2);
-  free(k3[0]);
-  free(k3[1]);
-  free(k3);
-  free(k4[0]);
-  free(k4[1]);
-  free(k4);
-
-  GLfloat* newThetas = (GLfloat*)malloc(n * sizeof(GLfloat));
-  GLfloat* newOmegas = (GLfloat*)malloc(n * sizeof(GLfloat));
-
-  for (int i = 0; i < n; i++) {
-    newThetas[i] = thetas[i] + thetaDeltas[i];
-    newOmegas[i] = omegas[i] + omegaDeltas[i];
-  }
-
-  free(thetaDeltas);
-  free(omegaDeltas);
-
-  GLfloat** result = (GLfloat**)malloc(2 * sizeof(GLfloat*));
-  result[0] = newThetas;
-  result[1] = newOmegas;
-
-  return result;
-}
-
-GLfloat** coordinates(size_t n, GLfloat* thetas) {
-  float x = ANCHOR_X;
-  float y = ANCHOR_Y;
-
-  GLfloat** coords = (GLfloat**)malloc(n * sizeof(GLfloat*));
-  for (int i = 0; i < n; i++) {
-    coords[i] = (GLfloat*)malloc(2 * sizeof(GLfloat));
-    x += sin(thetas[i]);
-    y += cos(thetas[i]);
-
-    coords[i][0] = x;
-    coords[i][1] = y;
-  }
-  
-  return coords;
-}
-
 int main(void) {
-  const GLchar* _vertexShaderSource = (const GLchar*)shaders_shader_vert;
-  const GLchar* _fragmentShaderSource = (const GLchar*)shaders_shader_frag;
-
-  GLchar* vertexShaderSource = (GLchar*)malloc(shaders_shader_vert_len + 1);
-  GLchar* fragmentShaderSource = (GLchar*)malloc(shaders_shader_frag_len + 1);
-
-  memcpy(vertexShaderSource, _vertexShaderSource, shaders_shader_vert_len);
-  memcpy(fragmentShaderSource, _fragmentShaderSource, shaders_shader_frag_len);
-
-  fragmentShaderSource[ shaders_shader_frag_len ] = '\0';
-  vertexShaderSource[ shaders_shader_vert_len ] = '\0';
-
   glfwInit();
 
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -347,62 +93,18 @@ int main(void) {
   }
 
   glfwMakeContextCurrent(window);
+  glfwSwapInterval(FRAME_PACING == PACING_VSYNC ? 1 : 0);
+  PROFILE_THREAD("render");
 
   gladLoadGL();
   glViewport(0, 0, 2 * WINDOW_WIDTH, 2 * WINDOW_HEIGHT);
 
-  GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertexShader, 1, (const GLchar* const*)&vertexShaderSource, NULL);
-  glCompileShader(vertexShader);
-
-  GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragmentShader, 1, (const GLchar* const*)&fragmentShaderSource, NULL);
-  glCompileShader(fragmentShader);
-
-  GLuint bobShaderProgram = glCreateProgram();
-  glAttachShader(bobShaderProgram, vertexShader);
-  glAttachShader(bobShaderProgram, fragmentShader);
-  glLinkProgram(bobShaderProgram);
-
-  GLuint rodFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-  const GLchar* rodFragmentShaderSource =
-    "#version 330 core\n"
-    "out vec4 FragColor;\n"
-    "void main()\n"
-    "{\n"
-    "    FragColor = vec4(0.5, 0.5, 0.5, 1.0);\n"
-    "}\n";
-  glShaderSource(rodFragmentShader, 1, &rodFragmentShaderSource, NULL);
-  glCompileShader(rodFragmentShader);
-
-  GLuint rodVertexShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(rodVertexShader, 1, (const GLchar* const*)&vertexShaderSource, NULL);
-  glCompileShader(rodVertexShader);
-
-  GLuint rodShaderProgram = glCreateProgram();
-  glAttachShader(rodShaderProgram, rodVertexShader);
-  glAttachShader(rodShaderProgram, rodFragmentShader);
-  glLinkProgram(rodShaderProgram);
-
-  glDeleteShader(vertexShader);
-  glDeleteShader(fragmentShader);
-  glDeleteShader(rodVertexShader);
-  glDeleteShader(rodFragmentShader);
-
-  GLuint bobVBO, bobVAO, bobEBO;
-
-  glGenVertexArrays(1, &bobVAO);
-  glGenBuffers(1, &bobVBO);
-  glGenBuffers(1, &bobEBO);
-
-  glBindVertexArray(bobVAO);
-
-  struct Bob bob1 = {0.0f, 0.0f, BOB_RADIUS, {1.0f, 0.0f, 0.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f};
-  struct Bob bob2 = {0.0f, 0.0f, BOB_RADIUS, {0.0f, 1.0f, 0.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f};
-  struct Bob bob3 = {0.0f, 0.0f, BOB_RADIUS, {0.0f, 0.0f, 1.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f};
-  struct Bob bob4 = {0.0f, 0.0f, BOB_RADIUS, {1.0f, 1.0f, 0.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f};
-  struct Bob bob5 = {0.0f, 0.0f, BOB_RADIUS, {1.0f, 0.0f, 1.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f};
-  struct Bob bob6 = {0.0f, 0.0f, BOB_RADIUS, {0.0f, 1.0f, 1.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f};
+  struct Bob bob1 = {BOB_RADIUS, {1.0f, 0.0f, 0.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f, 1.0f};
+  struct Bob bob2 = {BOB_RADIUS, {0.0f, 1.0f, 0.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f, 1.0f};
+  struct Bob bob3 = {BOB_RADIUS, {0.0f, 0.0f, 1.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f, 1.0f};
+  struct Bob bob4 = {BOB_RADIUS, {1.0f, 1.0f, 0.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f, 1.0f};
+  struct Bob bob5 = {BOB_RADIUS, {1.0f, 0.0f, 1.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f, 1.0f};
+  struct Bob bob6 = {BOB_RADIUS, {0.0f, 1.0f, 1.0f}, DEFAULT_THETA, DEFAULT_OMEGA, 1.0f, 1.0f};
 
   struct Bob* bobs[] = {&bob1, &bob2, &bob3, &bob4, &bob5, &bob6};
 
@@ -410,192 +112,200 @@ int main(void) {
   // size_t numBobs = 2;
   printf("Number of Bobs: %zu\n", numBobs);
 
-  glBindBuffer(GL_ARRAY_BUFFER, bobVBO);
-  glBufferData(GL_ARRAY_BUFFER, numBobs * RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
-
-  GLuint *allIndices = (GLuint*)malloc(numBobs * INDICES_PER_QUAD * sizeof(GLuint));
-  for (int i = 0; i < numBobs; ++i) {
-    GLuint base = (GLuint)(i * RECTANGLE_VERTICES);
-    int off = i * INDICES_PER_QUAD;
-    allIndices[off + 0] = base + 0;
-    allIndices[off + 1] = base + 1;
-    allIndices[off + 2] = base + 2;
-    allIndices[off + 3] = base + 1;
-    allIndices[off + 4] = base + 2;
-    allIndices[off + 5] = base + 3;
-  }
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bobEBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, numBobs * INDICES_PER_QUAD * sizeof(GLuint), allIndices, GL_STATIC_DRAW);
-  free(allIndices);
-
-  glVertexAttribPointer(0, VERTEX_FLOATS, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(GLfloat), (void*)0);
-  glEnableVertexAttribArray(0);
-
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
-
-  GLuint rodVAO, rodVBO, rodEBO;
-  glGenVertexArrays(1, &rodVAO);
-  glGenBuffers(1, &rodVBO);
-  glGenBuffers(1, &rodEBO);
-
-  glBindVertexArray(rodVAO);
-  glBindBuffer(GL_ARRAY_BUFFER, rodVBO);
-  glBufferData(GL_ARRAY_BUFFER, numBobs * RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
-
-  GLuint *rodAllIndices = (GLuint*)malloc(numBobs * INDICES_PER_QUAD * sizeof(GLuint));
-  for (int i = 0; i < numBobs; ++i) {
-    GLuint base = (GLuint)(i * RECTANGLE_VERTICES);
-    int off = i * INDICES_PER_QUAD;
-    rodAllIndices[off + 0] = base + 0;
-    rodAllIndices[off + 1] = base + 1;
-    rodAllIndices[off + 2] = base + 2;
-    rodAllIndices[off + 3] = base + 1;
-    rodAllIndices[off + 4] = base + 2;
-    rodAllIndices[off + 5] = base + 3;
+  struct Workspace* ws = createWorkspace(numBobs, PHYSICS_ENGINE);
+  struct Integrator* integrator = createIntegrator(ws, INTEGRATOR);
+  if (integrator == NULL) {
+    printf("Failed to create the integrator\n");
+    destroyWorkspace(ws);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return -1;
   }
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rodEBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, numBobs * INDICES_PER_QUAD * sizeof(GLuint), rodAllIndices, GL_STATIC_DRAW);
-  free(rodAllIndices);
-
-  glVertexAttribPointer(0, VERTEX_FLOATS, GL_FLOAT, GL_FALSE, VERTEX_FLOATS * sizeof(GLfloat), (void*)0);
-  glEnableVertexAttribArray(0);
-
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  GLfloat* thetas = (GLfloat*)malloc(numBobs * sizeof(GLfloat));
+  GLfloat* omegas = (GLfloat*)malloc(numBobs * sizeof(GLfloat));
 
-  float* batch = (float*)malloc(numBobs * RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(float));
-  float* rodBatch = (float*)malloc(numBobs * RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(float));
-
-  static double previousSeconds = 0.0;
-  while (!glfwWindowShouldClose(window)) {
-    GLfloat* thetas = (GLfloat*)malloc(numBobs * sizeof(GLfloat));
-    GLfloat* omegas = (GLfloat*)malloc(numBobs * sizeof(GLfloat));
-
-    for (int i = 0; i < numBobs; i++) {
-      thetas[i] = bobs[i]->theta;
-      omegas[i] = bobs[i]->omega;
-    }
-
-    GLfloat** rk4Result = rk4(TIME_STEP, numBobs, thetas, omegas);
-    GLfloat* newThetas = rk4Result[0];
-    GLfloat* newOmegas = rk4Result[1];
-
-    for (int i = 0; i < numBobs; i++) {
-      bobs[i]->theta = newThetas[i];
-      bobs[i]->omega = newOmegas[i];
-
-      thetas[i] = bobs[i]->theta;
-    }
-
-    free(omegas);
-    free(newThetas);
-    free(newOmegas);
-    free(rk4Result);
-
-    GLfloat** coords = coordinates(numBobs, thetas);
-    for (int i = 0; i < numBobs; i++) {
-      bobs[i]->centerX = ANCHOR_X + coords[i][0] * 1.5f / numBobs;
-      bobs[i]->centerY = ANCHOR_Y + coords[i][1] * 1.5f / numBobs;
-
-      free(coords[i]);
-    }
-
-    free(thetas);
-    free(coords);
-
-    for (int i = 0; i < numBobs; i++) {
-      float* verts = bobVertices(bobs[i]);
-      memcpy(batch + i * RECTANGLE_VERTICES * VERTEX_FLOATS, verts, RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(float));
-      free(verts);
-    }
-
-    glBindBuffer(GL_ARRAY_BUFFER, bobVBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, numBobs * RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(float), batch);
-
-    float* verts = rodVertices(ANCHOR_X, ANCHOR_Y, bobs[0]->centerX, bobs[0]->centerY, ROD_WIDTH);
-    memcpy(rodBatch, verts, RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(float));
-
-    for (int i = 0; i < numBobs - 1; i++) {
-      float* verts = rodVertices(bobs[i]->centerX, bobs[i]->centerY, bobs[i+1]->centerX, bobs[i+1]->centerY, ROD_WIDTH);
-      memcpy(rodBatch + ((i + 1) * RECTANGLE_VERTICES * VERTEX_FLOATS), verts, RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(float));
-      free(verts);
-    }
+  GLfloat* masses = (GLfloat*)malloc(numBobs * sizeof(GLfloat));
+  GLfloat* lengths = (GLfloat*)malloc(numBobs * sizeof(GLfloat));
+  float chainLength = 0.0f;
+  for (int i = 0; i < numBobs; i++) {
+    masses[i] = bobs[i]->mass;
+    lengths[i] = bobs[i]->length;
+    chainLength += lengths[i];
+  }
+  setChain(ws, masses, lengths);
+
+  float* radii = (float*)malloc(numBobs * sizeof(float));
+  float* colors = (float*)malloc(3 * numBobs * sizeof(float));
+  for (int i = 0; i < numBobs; i++) {
+    radii[i] = bobs[i]->radius;
+    colors[3 * i + 0] = bobs[i]->color.r;
+    colors[3 * i + 1] = bobs[i]->color.g;
+    colors[3 * i + 2] = bobs[i]->color.b;
+  }
 
-    glBindBuffer(GL_ARRAY_BUFFER, rodVBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, numBobs * RECTANGLE_VERTICES * VERTEX_FLOATS * sizeof(float), rodBatch);
+  float scale = 1.5f / chainLength;
+  struct Renderer* renderer = createRenderer(numBobs, lengths, radii, colors, ANCHOR_X, ANCHOR_Y, scale,
+                                             (GLADloadproc)glfwGetProcAddress);
+  struct Bob* tip = bobs[numBobs - 1];
+  struct Trail* trail = createTrail(TRAIL_LENGTH, tip->color.r, tip->color.g, tip->color.b);
+  free(colors);
+  free(radii);
+  if (renderer == NULL || trail == NULL) {
+    destroyTrail(trail);
+    destroyRenderer(renderer);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return -1;
+  }
 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+  // The capture target matches the window's framebuffer, which on high
+  // density displays is larger than the window.
+  int framebufferWidth, framebufferHeight;
+  glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+  const char* capturePath = CAPTURE_PATH;
+  struct Capture* capture = NULL;
+  if (capturePath != NULL) {
+    capture = createCapture(framebufferWidth, framebufferHeight, CAPTURE_FPS, capturePath);
+  }
 
-    glUseProgram(rodShaderProgram);
+  for (int i = 0; i < numBobs; i++) {
+    thetas[i] = bobs[i]->theta;
+    omegas[i] = bobs[i]->omega;
+  }
 
-    glBindVertexArray(rodVAO);
+  // The chain is stepped on its own thread from here on; the loop below
+  // only ever reads the latest state it published.
+  struct Simulation* simulation = createSimulation(integrator, TIME_STEP, thetas, omegas);
+  simulation->maxSubsteps = MAX_SUBSTEPS;
+  if (!startSimulation(simulation)) {
+    glfwSetWindowShouldClose(window, GLFW_TRUE);
+  }
 
-    for (int i = 0; i < numBobs; i++) {
-      glDrawElements(GL_TRIANGLES, INDICES_PER_QUAD, GL_UNSIGNED_INT, (const void*)(i * INDICES_PER_QUAD * sizeof(GLuint)));
-    }
-    glBindVertexArray(0);
+  unsigned long previousSteps = 0;
+  unsigned long previousBusy = 0;
+  unsigned long previousFrames = 0;
+  unsigned long long previousStreamed = 0;
+  double previousWait = 0.0;
 
+  struct Pacer* pacer = createPacer(FRAME_PACING, TARGET_FPS);
+  while (!glfwWindowShouldClose(window)) {
+    // Draw one physics step behind the newest state, blended between it
+    // and the step before, so motion stays smooth whatever the ratio of
+    // frame rate to physics rate. Angles are continuous across steps, so
+    // blending them directly is safe; the GPU turns them into positions.
+    // The blend is written straight into the renderer's mapped buffer.
+    PROFILE_SCOPE(ZONE_FRAME) {
+      const struct Snapshot* state;
+      float weight;
+      PROFILE_SCOPE(ZONE_GATHER) {
+        state = latestSnapshot(simulation);
+        weight = interpolationWeight(simulation, state);
+      }
 
-    glUseProgram(bobShaderProgram);
+      float* drawThetas;
+      PROFILE_SCOPE(ZONE_UPLOAD) {
+        drawThetas = chainAngles(renderer);
+      }
 
-    GLint iCenterLocation = glGetUniformLocation(bobShaderProgram, "iCenter");
-    GLint iColorLocation = glGetUniformLocation(bobShaderProgram, "iColor");
-    GLint iResolutionLocation = glGetUniformLocation(bobShaderProgram, "iResolution");
-    GLint iRadiusLocation = glGetUniformLocation(bobShaderProgram, "iRadius");
+      float tipX = ANCHOR_X, tipY = ANCHOR_Y;
+      PROFILE_SCOPE(ZONE_VERTICES) {
+        for (int i = 0; i < numBobs; i++) {
+          float theta = state->previousThetas[i] + weight * (state->thetas[i] - state->previousThetas[i]);
+          drawThetas[i] = theta;
+          tipX += scale * lengths[i] * sinf(theta);
+          tipY += scale * lengths[i] * cosf(theta);
+        }
+      }
 
-    glUniform2f(iResolutionLocation, WINDOW_WIDTH, WINDOW_HEIGHT);
+      PROFILE_SCOPE(ZONE_DRAW) {
+        if (capture != NULL) {
+          beginCapture(capture);
+        }
 
-    glBindVertexArray(bobVAO);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
 
-    for (int i = 0; i < numBobs; i++) {
-      void* color = &bobs[i]->color;
+        appendTrail(trail, tipX, tipY);
+        drawTrail(trail);
+        drawChain(renderer);
 
-      glUniform1f(iRadiusLocation, bobs[i]->radius);
-      glUniform3f(iCenterLocation, bobs[i]->centerX, bobs[i]->centerY, 0.0f);
-      glUniform3f(iColorLocation, ((float*)color)[0], ((float*)color)[1], ((float*)color)[2]);
+        if (capture != NULL) {
+          endCapture(capture);
+          presentCapture(capture, framebufferWidth, framebufferHeight);
+        }
+      }
 
-      glDrawElements(GL_TRIANGLES, INDICES_PER_QUAD, GL_UNSIGNED_INT, (const void*)(i * INDICES_PER_QUAD * sizeof(GLuint)));
+      PROFILE_SCOPE(ZONE_SWAP) {
+        glfwSwapBuffers(window);
+      }
+      glfwPollEvents();
     }
-    glBindVertexArray(0);
-
-    glfwSwapBuffers(window);
-    glfwPollEvents();
 
-    // Calculate the FPS, and set the window title accordingly. Limit FPS to 60.
-    double currentSeconds = glfwGetTime();
-    double elapsedSeconds = currentSeconds - previousSeconds;
-    if (elapsedSeconds > 0.016) {
-      previousSeconds = currentSeconds;
-
-      double fps = 1.0 / elapsedSeconds;
-      char tmp[128];
-      sprintf(tmp, "Multi-Pendulum Simulation - %.0f FPS", fps);
+    pace(pacer);
+
+    // Frames tile the interval, so their times add up to its length.
+    double elapsedSeconds = pacer->interval.seconds;
+    if (elapsedSeconds >= REPORT_INTERVAL) {
+      struct PacingReport pacing;
+      pacingReport(&pacer->interval, &pacing);
+      resetPacingStats(&pacer->interval);
+
+      // Physics rate and the fraction of wall time its thread spent
+      // stepping, measured over the same interval as the frame rate.
+      unsigned long steps = atomic_load_explicit(&simulation->steps, memory_order_relaxed);
+      unsigned long busy = atomic_load_explicit(&simulation->busyNanoseconds, memory_order_relaxed);
+      double stepRate = (steps - previousSteps) / elapsedSeconds;
+      double load = (busy - previousBusy) * 1e-9 / elapsedSeconds;
+      previousSteps = steps;
+      previousBusy = busy;
+
+      // Bytes streamed to the GPU and time spent waiting on its fences, per
+      // frame drawn since the last update.
+      const struct StreamBuffer* stream = renderer->angles;
+      unsigned long frames = stream->frames - previousFrames;
+      double streamed = frames > 0 ? (double)(stream->bytes - previousStreamed) / frames : 0.0;
+      double wait = frames > 0 ? (stream->waitSeconds - previousWait) / frames : 0.0;
+      previousFrames = stream->frames;
+      previousStreamed = stream->bytes;
+      previousWait = stream->waitSeconds;
+
+      char tmp[256];
+      sprintf(tmp,
+              "Multi-Pendulum Simulation - %.0f FPS, jitter %.2f ms, CPU %.0f%% (render %.0f%%), %.0f steps/s, "
+              "physics %.0f%%, %.0f B/frame, fence %.3f ms",
+              pacing.fps, pacing.jitterMs, pacing.processLoad * 100.0, pacing.threadLoad * 100.0, stepRate,
+              load * 100.0, streamed, wait * 1e3);
       glfwSetWindowTitle(window, tmp);
-    } else {
-      continue;
     }
   }
 
-  free(rodBatch);
-  free(batch);
-
-  glDeleteVertexArrays(1, &bobVAO);
-  glDeleteBuffers(1, &bobVBO);
-  glDeleteBuffers(1, &bobEBO);
-
-  glDeleteVertexArrays(1, &rodVAO);
-  glDeleteBuffers(1, &rodVBO);
-  glDeleteBuffers(1, &rodEBO);
+  struct PacingReport pacing;
+  pacingReport(&pacer->total, &pacing);
+  printf("Pacing %s: %lu frames at %.1f FPS, %.2f ms mean, %.2f ms jitter, %.2f ms worst, CPU %.0f%% (render %.0f%%)\n",
+         pacingModeName(pacer->mode), pacer->total.frames, pacing.fps, pacing.frameMs, pacing.jitterMs,
+         pacing.worstMs, pacing.processLoad * 100.0, pacing.threadLoad * 100.0);
+  destroyPacer(pacer);
+
+  destroySimulation(simulation);
+  PROFILE_WRITE(PROFILE_PATH);
+
+  if (capture != NULL) {
+    unsigned long frames = capture->frames > 0 ? capture->frames : 1;
+    printf("Captured %lu frames to %s: %.3f ms per frame on the render thread, %.3f ms of it waiting on the writer\n",
+           capture->frames, capturePath, capture->seconds * 1e3 / frames, capture->stallSeconds * 1e3 / frames);
+    destroyCapture(capture);
+  }
 
-  glDeleteProgram(bobShaderProgram);
-  glDeleteProgram(rodShaderProgram);
+  free(lengths);
+  free(masses);
+  free(omegas);
+  free(thetas);
+  destroyIntegrator(integrator);
+  destroyWorkspace(ws);
 
-  free(vertexShaderSource);
-  free(fragmentShaderSource);
+  destroyTrail(trail);
+  destroyRenderer(renderer);
 
   glfwDestroyWindow(window);
   glfwTerminate();
@@ -0,0 +1,112 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "pacing.h"
+
+static double clockSeconds(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double now(void) {
+  return clockSeconds(CLOCK_MONOTONIC);
+}
+
+static void sleepFor(double seconds) {
+  struct timespec ts;
+  ts.tv_sec = (time_t)seconds;
+  ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+  nanosleep(&ts, NULL);
+}
+
+static void record(struct PacingStats* stats, double frame) {
+  stats->frames++;
+  stats->seconds += frame;
+  stats->squares += frame * frame;
+  if (frame > stats->worst) {
+    stats->worst = frame;
+  }
+}
+
+struct Pacer* createPacer(enum PacingMode mode, double fps) {
+  struct Pacer* pacer = (struct Pacer*)calloc(1, sizeof(struct Pacer));
+  pacer->mode = mode;
+  pacer->period = 1.0 / fps;
+  pacer->spin = PACING_SPIN;
+
+  pacer->previous = now();
+  pacer->deadline = pacer->previous + pacer->period;
+  resetPacingStats(&pacer->interval);
+  resetPacingStats(&pacer->total);
+
+  return pacer;
+}
+
+void destroyPacer(struct Pacer* pacer) {
+  free(pacer);
+}
+
+void pace(struct Pacer* pacer) {
+  if (pacer->mode == PACING_DEADLINE) {
+    double remaining = pacer->deadline - now();
+    if (remaining > pacer->spin) {
+      sleepFor(remaining - pacer->spin);
+    }
+    while (now() < pacer->deadline) {
+    }
+
+    pacer->deadline += pacer->period;
+    double current = now();
+    if (current > pacer->deadline) {
+      pacer->deadline = current + pacer->period;
+    }
+  }
+
+  double current = now();
+  double frame = current - pacer->previous;
+  pacer->previous = current;
+
+  record(&pacer->interval, frame);
+  record(&pacer->total, frame);
+}
+
+void resetPacingStats(struct PacingStats* stats) {
+  stats->frames = 0;
+  stats->seconds = 0;
+  stats->squares = 0;
+  stats->worst = 0;
+
+  stats->wallStart = now();
+  stats->processStart = clockSeconds(CLOCK_PROCESS_CPUTIME_ID);
+  stats->threadStart = clockSeconds(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void pacingReport(const struct PacingStats* stats, struct PacingReport* report) {
+  double wall = now() - stats->wallStart;
+  double frames = stats->frames > 0 ? (double)stats->frames : 1.0;
+  double mean = stats->seconds / frames;
+  double variance = stats->squares / frames - mean * mean;
+
+  report->fps = stats->seconds > 0 ? stats->frames / stats->seconds : 0;
+  report->frameMs = mean * 1e3;
+  report->jitterMs = sqrt(variance > 0 ? variance : 0) * 1e3;
+  report->worstMs = stats->worst * 1e3;
+  report->processLoad = wall > 0 ? (clockSeconds(CLOCK_PROCESS_CPUTIME_ID) - stats->processStart) / wall : 0;
+  report->threadLoad = wall > 0 ? (clockSeconds(CLOCK_THREAD_CPUTIME_ID) - stats->threadStart) / wall : 0;
+}
+
+const char* pacingModeName(enum PacingMode mode) {
+  switch (mode) {
+    case PACING_VSYNC:
+      return "vsync";
+    case PACING_DEADLINE:
+      return "deadline";
+    case PACING_UNCAPPED:
+      return "uncapped";
+  }
+  return "unknown";
+}
@@ -0,0 +1,616 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "blocked.h"
+#include "physics.h"
+#include "specialized.h"
+
+// Only the buffers the chosen engine touches are allocated; the dense
+// n*n matrices would dominate memory for long ABA chains.
+struct Workspace* createWorkspace(size_t n, enum Engine engine) {
+  struct Workspace* ws = (struct Workspace*)calloc(1, sizeof(struct Workspace));
+  ws->n = n;
+  ws->engine = engine;
+
+  ws->masses = (float*)calloc(n, sizeof(float));
+  ws->lengths = (float*)calloc(n, sizeof(float));
+  ws->suffixMasses = (float*)calloc(n, sizeof(float));
+  ws->suffixMoments = (float*)calloc(n, sizeof(float));
+
+  if (engine == ENGINE_LU || engine == ENGINE_CHOLESKY) {
+    ws->weights = (float*)calloc(n * n, sizeof(float));
+    ws->sines = (float*)calloc(n, sizeof(float));
+    ws->cosines = (float*)calloc(n, sizeof(float));
+    ws->weightedSines = (float*)calloc(n, sizeof(float));
+    ws->weightedCosines = (float*)calloc(n, sizeof(float));
+
+    ws->A = (float*)calloc(n * n, sizeof(float));
+    ws->B = (float*)calloc(n, sizeof(float));
+    ws->x = (float*)calloc(n, sizeof(float));
+  }
+
+  if (engine == ENGINE_CHOLESKY && n >= BLOCKED_MIN_N) {
+    ws->panel = (float*)calloc(BLOCKED_PANEL * n, sizeof(float));
+  }
+
+  if (engine == ENGINE_LU) {
+    ws->L = (float*)calloc(n * n, sizeof(float));
+    ws->U = (float*)calloc(n * n, sizeof(float));
+    ws->y = (float*)calloc(n, sizeof(float));
+  }
+
+  if (engine == ENGINE_ABA) {
+    ws->abaPositions = (double*)calloc(2 * n, sizeof(double));
+    ws->abaVelocities = (double*)calloc(3 * n, sizeof(double));
+    ws->abaBias = (double*)calloc(3 * n, sizeof(double));
+    ws->abaU = (double*)calloc(3 * n, sizeof(double));
+    ws->abaD = (double*)calloc(n, sizeof(double));
+    ws->abaTorque = (double*)calloc(n, sizeof(double));
+  }
+
+  ws->stageThetas = (float*)calloc(n, sizeof(float));
+  ws->stageOmegas = (float*)calloc(n, sizeof(float));
+
+  for (int s = 0; s < 4; s++) {
+    ws->kThetas[s] = (float*)calloc(n, sizeof(float));
+    ws->kOmegas[s] = (float*)calloc(n, sizeof(float));
+  }
+
+  setChain(ws, NULL, NULL);
+  return ws;
+}
+
+void destroyWorkspace(struct Workspace* ws) {
+  if (ws == NULL) {
+    return;
+  }
+
+  for (int s = 0; s < 4; s++) {
+    free(ws->kThetas[s]);
+    free(ws->kOmegas[s]);
+  }
+
+  free(ws->stageThetas);
+  free(ws->stageOmegas);
+
+  free(ws->abaTorque);
+  free(ws->abaD);
+  free(ws->abaU);
+  free(ws->abaBias);
+  free(ws->abaVelocities);
+  free(ws->abaPositions);
+
+  free(ws->panel);
+  free(ws->x);
+  free(ws->y);
+  free(ws->U);
+  free(ws->L);
+  free(ws->B);
+  free(ws->A);
+
+  free(ws->weightedCosines);
+  free(ws->weightedSines);
+  free(ws->cosines);
+  free(ws->sines);
+  free(ws->weights);
+
+  free(ws->suffixMoments);
+  free(ws->suffixMasses);
+  free(ws->lengths);
+  free(ws->masses);
+
+  free(ws);
+}
+
+// NULL masses or lengths mean all ones. Everything mass- or length-dependent
+// is folded into the suffix sums and the dense weights here, once, so the
+// per-evaluation cost is the same as for the unit chain.
+void setChain(struct Workspace* ws, const float* masses, const float* lengths) {
+  size_t n = ws->n;
+
+  for (size_t i = 0; i < n; i++) {
+    ws->masses[i] = masses != NULL ? masses[i] : 1.0f;
+    ws->lengths[i] = lengths != NULL ? lengths[i] : 1.0f;
+  }
+
+  float mu = 0;
+  for (size_t i = n; i-- > 0;) {
+    mu += ws->masses[i];
+    ws->suffixMasses[i] = mu;
+    ws->suffixMoments[i] = mu * ws->lengths[i];
+  }
+
+  if (ws->weights != NULL) {
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = 0; j < n; j++) {
+        ws->weights[i * n + j] = ws->suffixMasses[i > j ? i : j] * ws->lengths[i] * ws->lengths[j];
+      }
+    }
+  }
+}
+
+// Reference kernels for the unit-mass, unit-length chain, one sin/cos per
+// pair. The workspace path below handles general chains.
+void createMatrixA(size_t n, const float* thetas, float* A) {
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      float value = (n - fmax(i, j)) * cos(thetas[i] - thetas[j]);
+      A[i * n + j] = value;
+    }
+  }
+}
+
+void createVectorB(size_t n, const float* thetas, const float* omegas, float* B) {
+  for (int i = 0; i < n; i++) {
+    float b_i = 0;
+    for (int j = 0; j < n; j++) {
+      b_i -= (n - fmax(i, j)) * omegas[j] * omegas[j] * sin(thetas[i] - thetas[j]);
+    }
+    b_i -= (n - i) * GRAVITY * sin(thetas[i]);
+
+    B[i] = b_i;
+  }
+}
+
+// Same A and B as createMatrixA() and createVectorB(), but with one sin/cos
+// per angle instead of one per (i, j) pair, using
+//   cos(ti - tj) = ci cj + si sj,  sin(ti - tj) = si cj - ci sj.
+// That splits row i of B into two weighted dot products,
+//   B_i = -si * sum_j W_ij w_j^2 cj + ci * sum_j W_ij w_j^2 sj - mu_i l_i g si,
+// and leaves only multiply-adds over contiguous rows in the O(n^2) part.
+void assembleSystem(struct Workspace* ws, const float* thetas, const float* omegas) {
+  size_t n = ws->n;
+
+  const float* W = ws->weights;
+  float* s = ws->sines;
+  float* c = ws->cosines;
+  float* omegaS = ws->weightedSines;
+  float* omegaC = ws->weightedCosines;
+  float* A = ws->A;
+  float* B = ws->B;
+
+  for (size_t i = 0; i < n; i++) {
+    s[i] = sinf(thetas[i]);
+    c[i] = cosf(thetas[i]);
+
+    float omega2 = omegas[i] * omegas[i];
+    omegaS[i] = omega2 * s[i];
+    omegaC[i] = omega2 * c[i];
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    const float* row = W + i * n;
+    float* out = A + i * n;
+    float si = s[i], ci = c[i];
+
+    float sumC = 0, sumS = 0;
+    for (size_t j = 0; j < n; j++) {
+      out[j] = row[j] * (ci * c[j] + si * s[j]);
+      sumC += row[j] * omegaC[j];
+      sumS += row[j] * omegaS[j];
+    }
+
+    B[i] = -si * sumC + ci * sumS - ws->suffixMoments[i] * GRAVITY * si;
+  }
+}
+
+// Only A = M(theta), for callers that supply their own right-hand side.
+// Leaves the per-angle sines and cosines in the workspace.
+void assembleMassMatrix(struct Workspace* ws, const float* thetas) {
+  size_t n = ws->n;
+
+  const float* W = ws->weights;
+  float* s = ws->sines;
+  float* c = ws->cosines;
+  float* A = ws->A;
+
+  for (size_t i = 0; i < n; i++) {
+    s[i] = sinf(thetas[i]);
+    c[i] = cosf(thetas[i]);
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    const float* row = W + i * n;
+    float* out = A + i * n;
+    float si = s[i], ci = c[i];
+
+    for (size_t j = 0; j < n; j++) {
+      out[j] = row[j] * (ci * c[j] + si * s[j]);
+    }
+  }
+}
+
+// L and U are fully overwritten, including the zero triangles, so the
+// caller may hand in dirty scratch buffers.
+void lu_decompose(size_t n, const float* A, float* L, float* U) {
+  memset(L, 0, n * n * sizeof(float));
+  memset(U, 0, n * n * sizeof(float));
+
+  for (int i = 0; i < n; i++) {
+    for (int k = i; k < n; k++) {
+      float sum = 0;
+      for (int j = 0; j < i; j++) {
+        sum += L[i * n + j] * U[j * n + k];
+      }
+      U[i * n + k] = A[i * n + k] - sum;
+    }
+
+    for (int k = i; k < n; k++) {
+      if (i == k) {
+        L[i * n + i] = 1;
+      } else {
+        float sum = 0;
+        for (int j = 0; j < i; j++) {
+          sum += L[k * n + j] * U[j * n + i];
+        }
+        L[k * n + i] = (A[k * n + i] - sum) / U[i * n + i];
+      }
+    }
+  }
+}
+
+void forward_substitution(size_t n, const float* L, const float* B, float* y) {
+  for (int i = 0; i < n; i++) {
+    float sum = 0;
+    for (int j = 0; j < i; j++) {
+      sum += L[i * n + j] * y[j];
+    }
+    y[i] = B[i] - sum;
+  }
+}
+
+void backward_substitution(size_t n, const float* U, const float* y, float* x) {
+  for (int i = n - 1; i >= 0; i--) {
+    float sum = 0;
+    for (int j = i + 1; j < n; j++) {
+      sum += U[i * n + j] * x[j];
+    }
+    x[i] = (y[i] - sum) / U[i * n + i];
+  }
+}
+
+void solveLinearSystem(struct Workspace* ws, const float* A, const float* B, float* result) {
+  size_t n = ws->n;
+
+  lu_decompose(n, A, ws->L, ws->U);
+  forward_substitution(n, ws->L, B, ws->y);
+  backward_substitution(n, ws->U, ws->y, ws->x);
+
+  memcpy(result, ws->x, n * sizeof(float));
+}
+
+// LDL^T factorisation of the symmetric positive definite mass matrix,
+// in place in the lower triangle of A: the strict lower part becomes the
+// unit lower factor L and the diagonal becomes D. The upper triangle is
+// neither read nor written. Row j is first overwritten with L[j][k] * D[k]
+// so every inner product runs over two contiguous rows.
+void ldlt_decompose(size_t n, float* A) {
+  for (size_t j = 0; j < n; j++) {
+    float* row = A + j * n;
+
+    for (size_t k = 0; k < j; k++) {
+      const float* rowK = A + k * n;
+      float sum = 0;
+      for (size_t m = 0; m < k; m++) {
+        sum += row[m] * rowK[m];
+      }
+      row[k] -= sum;
+    }
+
+    float d = row[j];
+    for (size_t k = 0; k < j; k++) {
+      float l = row[k] / A[k * n + k];
+      d -= l * row[k];
+      row[k] = l;
+    }
+    row[j] = d;
+  }
+}
+
+// Solves L D L^T x = b in place, with x holding b on entry. The transposed
+// sweep walks rows of L too, so no strided column access is needed.
+void ldlt_substitution(size_t n, const float* LD, float* x) {
+  for (size_t i = 0; i < n; i++) {
+    const float* row = LD + i * n;
+    float sum = 0;
+    for (size_t k = 0; k < i; k++) {
+      sum += row[k] * x[k];
+    }
+    x[i] -= sum;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    x[i] /= LD[i * n + i];
+  }
+
+  for (size_t k = n; k-- > 0;) {
+    const float* row = LD + k * n;
+    float xk = x[k];
+    for (size_t i = 0; i < k; i++) {
+      x[i] -= row[i] * xk;
+    }
+  }
+}
+
+// Destroys the lower triangle of A.
+void solveSymmetricSystem(struct Workspace* ws, float* A, const float* B, float* result) {
+  size_t n = ws->n;
+
+  if (ws->panel != NULL) {
+    blocked_ldlt_decompose(n, A, ws->panel, ws->pool);
+  } else {
+    ldlt_decompose(n, A);
+  }
+  memcpy(result, B, n * sizeof(float));
+  ldlt_substitution(n, A, result);
+}
+
+// Featherstone's articulated-body algorithm specialised to the planar
+// chain. Spatial vectors are (angular, x, y) in world coordinates about the
+// anchor, so every parent-to-child transform is the identity and only the
+// joint axis s_i = (1, q_y, -q_x) moves with the joint position q.
+//
+// Bob positions are mirrored in x relative to the drawn chain, where
+// x = sum_j l_j sin(theta_j), so that a positive omega is a
+// counter-clockwise rotation; the dynamics are unchanged by the mirror.
+// Joint rates are relative (omega_i - omega_i-1) and the returned
+// accelerations are converted back to absolute ones. Gravity enters as an
+// upward acceleration of the anchor.
+void articulatedBodyAccelerations(struct Workspace* ws, const float* thetas, const float* omegas, float* alphas) {
+  size_t n = ws->n;
+
+  double* P = ws->abaPositions;
+  double* V = ws->abaVelocities;
+  double* C = ws->abaBias;
+  double* U = ws->abaU;
+  double* D = ws->abaD;
+  double* u = ws->abaTorque;
+
+  double qx = 0, qy = 0;
+  double vw = 0, vx = 0, vy = 0;
+  double previousOmega = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    double rate = omegas[i] - previousOmega;
+    previousOmega = omegas[i];
+
+    // v_i = v_i-1 + s_i * rate, c_i = v_i x (s_i * rate)
+    double sw = rate, sx = qy * rate, sy = -qx * rate;
+    vw += sw; vx += sx; vy += sy;
+
+    C[3 * i + 0] = 0;
+    C[3 * i + 1] = vy * sw - vw * sy;
+    C[3 * i + 2] = vw * sx - vx * sw;
+
+    V[3 * i + 0] = vw;
+    V[3 * i + 1] = vx;
+    V[3 * i + 2] = vy;
+
+    double length = ws->lengths[i];
+    qx -= length * sin(thetas[i]);
+    qy += length * cos(thetas[i]);
+    P[2 * i + 0] = qx;
+    P[2 * i + 1] = qy;
+  }
+
+  // Articulated inertia (symmetric, upper triangle) and bias force handed
+  // from child to parent.
+  double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+  double pw = 0, px = 0, py = 0;
+
+  for (size_t k = n; k-- > 0;) {
+    double x = P[2 * k + 0], y = P[2 * k + 1];
+    double jx = k > 0 ? P[2 * (k - 1) + 0] : 0;
+    double jy = k > 0 ? P[2 * (k - 1) + 1] : 0;
+    double w = V[3 * k + 0], wx = V[3 * k + 1], wy = V[3 * k + 2];
+
+    // Point mass m at (x, y): I = m [[x^2+y^2, -y, x], [-y, 1, 0], [x, 0, 1]]
+    double m = ws->masses[k];
+    a00 += m * (x * x + y * y); a01 -= m * y; a02 += m * x;
+    a11 += m; a22 += m;
+
+    // p = v x* (I v); the angular part of I v drops out of the planar product.
+    double hx = m * (-y * w + wx);
+    double hy = m * (x * w + wy);
+    pw += -wy * hx + wx * hy;
+    px -= w * hy;
+    py += w * hx;
+
+    double sw = 1, sx = jy, sy = -jx;
+    double Uw = a00 * sw + a01 * sx + a02 * sy;
+    double Ux = a01 * sw + a11 * sx + a12 * sy;
+    double Uy = a02 * sw + a12 * sx + a22 * sy;
+    double Dk = sw * Uw + sx * Ux + sy * Uy;
+    double uk = -(sw * pw + sx * px + sy * py);
+
+    U[3 * k + 0] = Uw;
+    U[3 * k + 1] = Ux;
+    U[3 * k + 2] = Uy;
+    D[k] = Dk;
+    u[k] = uk;
+
+    a00 -= Uw * Uw / Dk; a01 -= Uw * Ux / Dk; a02 -= Uw * Uy / Dk;
+    a11 -= Ux * Ux / Dk; a12 -= Ux * Uy / Dk; a22 -= Uy * Uy / Dk;
+
+    double cw = C[3 * k + 0], cx = C[3 * k + 1], cy = C[3 * k + 2];
+    double scale = uk / Dk;
+    pw += a00 * cw + a01 * cx + a02 * cy + Uw * scale;
+    px += a01 * cw + a11 * cx + a12 * cy + Ux * scale;
+    py += a02 * cw + a12 * cx + a22 * cy + Uy * scale;
+  }
+
+  double aw = 0, ax = 0, ay = -GRAVITY;
+  double alpha = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    double jx = i > 0 ? P[2 * (i - 1) + 0] : 0;
+    double jy = i > 0 ? P[2 * (i - 1) + 1] : 0;
+
+    aw += C[3 * i + 0];
+    ax += C[3 * i + 1];
+    ay += C[3 * i + 2];
+
+    double qdd = (u[i] - (U[3 * i + 0] * aw + U[3 * i + 1] * ax + U[3 * i + 2] * ay)) / D[i];
+
+    aw += qdd;
+    ax += jy * qdd;
+    ay -= jx * qdd;
+
+    alpha += qdd;
+    alphas[i] = alpha;
+  }
+}
+
+// Total mechanical energy, taking the anchor as zero potential. Accumulates
+// bob velocities link by link, so it is O(n) and needs no scratch. NULL
+// masses or lengths mean all ones.
+static double chainEnergyOf(size_t n, const float* masses, const float* lengths, const float* thetas,
+                            const float* omegas) {
+  double vx = 0, vy = 0, y = 0;
+  double kinetic = 0, potential = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    double m = masses != NULL ? masses[i] : 1.0;
+    double l = lengths != NULL ? lengths[i] : 1.0;
+
+    vx += l * omegas[i] * cos(thetas[i]);
+    vy -= l * omegas[i] * sin(thetas[i]);
+    y += l * cos(thetas[i]);
+
+    kinetic += 0.5 * m * (vx * vx + vy * vy);
+    potential -= m * GRAVITY * y;
+  }
+
+  return kinetic + potential;
+}
+
+// Unit-mass, unit-length chain.
+double energy(size_t n, const float* thetas, const float* omegas) {
+  return chainEnergyOf(n, NULL, NULL, thetas, omegas);
+}
+
+// The chain set on the workspace with setChain().
+double chainEnergy(const struct Workspace* ws, const float* thetas, const float* omegas) {
+  return chainEnergyOf(ws->n, ws->masses, ws->lengths, thetas, omegas);
+}
+
+// Solves M x = rhs with the engine's dense factorisation, where M has just
+// been assembled into ws->A.
+static void solveMassMatrix(struct Workspace* ws, const float* rhs, float* x) {
+  if (ws->engine == ENGINE_CHOLESKY) {
+    solveSymmetricSystem(ws, ws->A, rhs, x);
+  } else {
+    solveLinearSystem(ws, ws->A, rhs, x);
+  }
+}
+
+// p = M(theta) omega, the momenta conjugate to the link angles.
+void generalizedMomenta(struct Workspace* ws, const float* thetas, const float* omegas, float* momenta) {
+  size_t n = ws->n;
+
+  assembleMassMatrix(ws, thetas);
+
+  for (size_t i = 0; i < n; i++) {
+    const float* row = ws->A + i * n;
+    float sum = 0;
+    for (size_t j = 0; j < n; j++) {
+      sum += row[j] * omegas[j];
+    }
+    momenta[i] = sum;
+  }
+}
+
+void generalizedVelocities(struct Workspace* ws, const float* thetas, const float* momenta, float* omegas) {
+  assembleMassMatrix(ws, thetas);
+  solveMassMatrix(ws, momenta, omegas);
+}
+
+// Hamilton's equations for H = p^T M^-1 p / 2 + V:
+//   theta' = omega = M^-1 p
+//   p_k'   = -omega_k sum_j W_kj sin(theta_k - theta_j) omega_j - g mu_k l_k sin(theta_k)
+// The sum expands with the same identities as assembleSystem(). Costs one
+// dense factorisation, like f(), and is counted as an evaluation. Only the
+// dense engines can provide M.
+void hamiltonianField(struct Workspace* ws, const float* thetas, const float* momenta, float* dThetas, float* dMomenta) {
+  size_t n = ws->n;
+  ws->evaluations++;
+
+  const float* W = ws->weights;
+  float* s = ws->sines;
+  float* c = ws->cosines;
+  float* omegaS = ws->weightedSines;
+  float* omegaC = ws->weightedCosines;
+
+  generalizedVelocities(ws, thetas, momenta, dThetas);
+
+  for (size_t i = 0; i < n; i++) {
+    omegaS[i] = dThetas[i] * s[i];
+    omegaC[i] = dThetas[i] * c[i];
+  }
+
+  for (size_t k = 0; k < n; k++) {
+    const float* row = W + k * n;
+    float sumC = 0, sumS = 0;
+    for (size_t j = 0; j < n; j++) {
+      sumC += row[j] * omegaC[j];
+      sumS += row[j] * omegaS[j];
+    }
+
+    dMomenta[k] = -dThetas[k] * (s[k] * sumC - c[k] * sumS) - ws->suffixMoments[k] * GRAVITY * s[k];
+  }
+}
+
+void f(struct Workspace* ws, const float* thetas, const float* omegas, float* dThetas, float* dOmegas) {
+  size_t n = ws->n;
+  ws->evaluations++;
+
+  if (ws->engine == ENGINE_ABA) {
+    articulatedBodyAccelerations(ws, thetas, omegas, dOmegas);
+  } else if (ws->engine == ENGINE_CHOLESKY) {
+    if (!specializedAccelerations(ws, thetas, omegas, dOmegas)) {
+      assembleSystem(ws, thetas, omegas);
+      solveSymmetricSystem(ws, ws->A, ws->B, dOmegas);
+    }
+  } else {
+    assembleSystem(ws, thetas, omegas);
+    solveLinearSystem(ws, ws->A, ws->B, dOmegas);
+  }
+
+  // omegas may alias ws->stageOmegas, never dThetas.
+  memcpy(dThetas, omegas, n * sizeof(float));
+}
+
+void rk4(struct Workspace* ws, float dt, float* thetas, float* omegas) {
+  size_t n = ws->n;
+
+  float** kT = ws->kThetas;
+  float** kO = ws->kOmegas;
+  float* sT = ws->stageThetas;
+  float* sO = ws->stageOmegas;
+
+  f(ws, thetas, omegas, kT[0], kO[0]);
+
+  for (int i = 0; i < n; i++) {
+    sT[i] = thetas[i] + (dt / 2.0f) * kT[0][i];
+    sO[i] = omegas[i] + (dt / 2.0f) * kO[0][i];
+  }
+  f(ws, sT, sO, kT[1], kO[1]);
+
+  for (int i = 0; i < n; i++) {
+    sT[i] = thetas[i] + (dt / 2.0f) * kT[1][i];
+    sO[i] = omegas[i] + (dt / 2.0f) * kO[1][i];
+  }
+  f(ws, sT, sO, kT[2], kO[2]);
+
+  for (int i = 0; i < n; i++) {
+    sT[i] = thetas[i] + dt * kT[2][i];
+    sO[i] = omegas[i] + dt * kO[2][i];
+  }
+  f(ws, sT, sO, kT[3], kO[3]);
+
+  for (int i = 0; i < n; i++) {
+    thetas[i] += (kT[0][i] + 2.0f * kT[1][i] + 2.0f * kT[2][i] + kT[3][i]) * (dt / 6.0f);
+    omegas[i] += (kO[0][i] + 2.0f * kO[1][i] + 2.0f * kO[2][i] + kO[3][i]) * (dt / 6.0f);
+  }
+}
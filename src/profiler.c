@@ -0,0 +1,223 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "profiler.h"
+
+// Durations below PROFILE_SUBBUCKETS ns get a bucket each; above, every
+// doubling is split into PROFILE_SUBBUCKETS equal buckets.
+#define PROFILE_BUCKETS (62 * PROFILE_SUBBUCKETS)
+#define SUBBUCKET_BITS 3
+
+#define PROFILE_THREADS 16
+
+struct ProfileEvent {
+  int zone;
+  int thread;
+  long long start;
+  long long duration;
+};
+
+struct ProfileHistogram {
+  atomic_ulong buckets[PROFILE_BUCKETS];
+  atomic_ulong count;
+  atomic_ullong total;
+  atomic_llong max;
+};
+
+static const char* zoneNames[PROFILE_ZONES] = {
+  "frame", "gather", "upload", "vertices", "draw", "swap", "step",
+};
+
+static struct ProfileHistogram histograms[PROFILE_ZONES];
+
+// Allocated by the first event, so builds without PROFILE never pay for it.
+static _Atomic(struct ProfileEvent*) events;
+static atomic_ulong eventCount;
+
+static const char* threadNames[PROFILE_THREADS];
+static atomic_int threadCount;
+static _Thread_local int threadIndex = -1;
+
+static int currentThread(void) {
+  if (threadIndex < 0) {
+    threadIndex = atomic_fetch_add_explicit(&threadCount, 1, memory_order_relaxed);
+  }
+  return threadIndex;
+}
+
+static struct ProfileEvent* eventLog(void) {
+  struct ProfileEvent* log = atomic_load_explicit(&events, memory_order_acquire);
+  if (log == NULL) {
+    struct ProfileEvent* fresh = (struct ProfileEvent*)calloc(PROFILE_EVENTS, sizeof(struct ProfileEvent));
+    if (atomic_compare_exchange_strong_explicit(&events, &log, fresh, memory_order_acq_rel, memory_order_acquire)) {
+      log = fresh;
+    } else {
+      free(fresh);
+    }
+  }
+  return log;
+}
+
+static int bucketOf(long long duration) {
+  if (duration < PROFILE_SUBBUCKETS) {
+    return duration < 0 ? 0 : (int)duration;
+  }
+
+  int exponent = 63 - __builtin_clzll((unsigned long long)duration);
+  int sub = (int)(duration >> (exponent - SUBBUCKET_BITS)) - PROFILE_SUBBUCKETS;
+  return (exponent - SUBBUCKET_BITS + 1) * PROFILE_SUBBUCKETS + sub;
+}
+
+// Midpoint of a bucket, in nanoseconds.
+static double bucketValue(int bucket) {
+  if (bucket < PROFILE_SUBBUCKETS) {
+    return bucket;
+  }
+
+  int exponent = bucket / PROFILE_SUBBUCKETS + SUBBUCKET_BITS - 1;
+  int sub = bucket % PROFILE_SUBBUCKETS;
+  double width = (double)(1ULL << (exponent - SUBBUCKET_BITS));
+  return (PROFILE_SUBBUCKETS + sub + 0.5) * width;
+}
+
+static double percentile(struct ProfileHistogram* histogram, double fraction) {
+  unsigned long count = atomic_load(&histogram->count);
+  unsigned long rank = (unsigned long)(fraction * count + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  unsigned long seen = 0;
+  for (int b = 0; b < PROFILE_BUCKETS; b++) {
+    seen += atomic_load(&histogram->buckets[b]);
+    if (seen >= rank) {
+      return bucketValue(b);
+    }
+  }
+  return 0;
+}
+
+long long profileNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void profileRecord(enum ProfileZone zone, long long start, long long end) {
+  long long duration = end - start;
+  struct ProfileHistogram* histogram = &histograms[zone];
+
+  atomic_fetch_add_explicit(&histogram->buckets[bucketOf(duration)], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&histogram->total, (unsigned long long)duration, memory_order_relaxed);
+  long long max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+  while (duration > max &&
+         !atomic_compare_exchange_weak_explicit(&histogram->max, &max, duration, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+
+  unsigned long index = atomic_fetch_add_explicit(&eventCount, 1, memory_order_relaxed);
+  struct ProfileEvent* log = index < PROFILE_EVENTS ? eventLog() : NULL;
+  if (log != NULL) {
+    struct ProfileEvent* event = log + index;
+    event->zone = zone;
+    event->thread = currentThread();
+    event->start = start;
+    event->duration = duration;
+  }
+}
+
+void profileThread(const char* name) {
+  int thread = currentThread();
+  if (thread < PROFILE_THREADS) {
+    threadNames[thread] = name;
+  }
+}
+
+static int endsWith(const char* string, const char* suffix) {
+  size_t length = strlen(string), suffixLength = strlen(suffix);
+  return length >= suffixLength && strcmp(string + length - suffixLength, suffix) == 0;
+}
+
+static void writeTrace(FILE* file) {
+  struct ProfileEvent* log = atomic_load(&events);
+  unsigned long count = log != NULL ? atomic_load(&eventCount) : 0;
+  if (count > PROFILE_EVENTS) {
+    count = PROFILE_EVENTS;
+  }
+
+  long long base = count > 0 ? log[0].start : 0;
+  for (unsigned long e = 1; e < count; e++) {
+    if (log[e].start < base) {
+      base = log[e].start;
+    }
+  }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  int threads = atomic_load(&threadCount);
+  for (int t = 0; t < threads && t < PROFILE_THREADS; t++) {
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n", t,
+            threadNames[t] != NULL ? threadNames[t] : "thread");
+  }
+
+  for (unsigned long e = 0; e < count; e++) {
+    const struct ProfileEvent* event = &log[e];
+    fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+            zoneNames[event->zone], event->thread, (event->start - base) * 1e-3, event->duration * 1e-3,
+            e + 1 < count ? "," : "");
+  }
+
+  fprintf(file, "]}\n");
+}
+
+void profileWrite(const char* path) {
+  int trace = endsWith(path, ".json");
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    printf("Failed to open %s\n", path);
+  }
+
+  if (file != NULL && !trace) {
+    fprintf(file, "zone,count,mean_us,p50_us,p99_us,max_us\n");
+  }
+
+  printf("%-12s %10s %10s %10s %10s %10s\n", "zone", "count", "mean us", "p50 us", "p99 us", "max us");
+  for (int z = 0; z < PROFILE_ZONES; z++) {
+    struct ProfileHistogram* histogram = &histograms[z];
+    unsigned long count = atomic_load(&histogram->count);
+    if (count == 0) {
+      continue;
+    }
+
+    // A bucket's midpoint can overshoot the largest sample in it.
+    double mean = (double)atomic_load(&histogram->total) / count * 1e-3;
+    double max = atomic_load(&histogram->max) * 1e-3;
+    double p50 = fmin(percentile(histogram, 0.50) * 1e-3, max);
+    double p99 = fmin(percentile(histogram, 0.99) * 1e-3, max);
+
+    printf("%-12s %10lu %10.3f %10.3f %10.3f %10.3f\n", zoneNames[z], count, mean, p50, p99, max);
+    if (file != NULL && !trace) {
+      fprintf(file, "%s,%lu,%.3f,%.3f,%.3f,%.3f\n", zoneNames[z], count, mean, p50, p99, max);
+    }
+  }
+
+  if (file != NULL && trace) {
+    writeTrace(file);
+  }
+
+  unsigned long recorded = atomic_load(&eventCount);
+  if (trace && recorded > PROFILE_EVENTS) {
+    printf("Trace holds the first %d of %lu events\n", PROFILE_EVENTS, recorded);
+  }
+
+  if (file != NULL) {
+    fclose(file);
+  }
+}
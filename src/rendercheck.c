@@ -0,0 +1,426 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "capture.h"
+#include "renderer.h"
+
+// Draws a fixed chain with the renderer into an offscreen framebuffer and
+// checks the pixels the vertex shader should have produced against
+// positions computed on the CPU. Needs EGL with an OpenGL 3.3 core driver;
+// under Mesa, LIBGL_ALWAYS_SOFTWARE=1 selects llvmpipe, so no GPU or
+// display is required.
+
+#define DEFAULT_LINKS 6
+#define DEFAULT_SIZE 800
+
+#define ANCHOR_X 0.0f
+#define ANCHOR_Y 0.5f
+#define BOB_RADIUS 0.05f
+
+#define PI 3.14159265358979323846f
+
+// Frames drawn before the checked one: enough to wrap the streamed ring,
+// leaving the checked frame in a recycled region away from offset zero.
+#define WARMUP_FRAMES (STREAM_REGIONS + 1)
+
+// The trail check appends more samples than fit, along a horizontal line,
+// so the ring has wrapped and its oldest samples must no longer be drawn.
+#define TRAIL_CAPACITY 64
+#define TRAIL_SAMPLES 96
+
+// Frames recorded by the capture check: more than the readback ring holds,
+// so some are collected during the run and the rest when it is destroyed.
+#define CAPTURE_FRAMES (CAPTURE_PBOS + 2)
+
+struct Options {
+  size_t links;
+  int size;
+  const char* output;
+  int orphan;
+  const char* capture;
+};
+
+struct Image {
+  int size;
+  unsigned char* pixels;
+};
+
+static void usage(const char* program) {
+  printf("usage: %s [-n links] [-s pixels] [-o image.ppm] [-m persistent|orphan] [-c capture]\n", program);
+}
+
+static int parseOptions(int argc, char** argv, struct Options* options) {
+  options->links = DEFAULT_LINKS;
+  options->size = DEFAULT_SIZE;
+  options->output = NULL;
+  options->orphan = 0;
+  options->capture = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+      usage(argv[0]);
+      return 0;
+    }
+
+    const char* value = argv[++i];
+
+    switch (argv[i - 1][1]) {
+      case 'n':
+        options->links = strtoul(value, NULL, 10);
+        break;
+      case 's':
+        options->size = atoi(value);
+        break;
+      case 'o':
+        options->output = value;
+        break;
+      case 'm':
+        if (strcmp(value, "orphan") != 0 && strcmp(value, "persistent") != 0) {
+          usage(argv[0]);
+          return 0;
+        }
+        options->orphan = strcmp(value, "orphan") == 0;
+        break;
+      case 'c':
+        options->capture = value;
+        break;
+      default:
+        usage(argv[0]);
+        return 0;
+    }
+  }
+
+  if (options->links == 0 || options->size < 64) {
+    usage(argv[0]);
+    return 0;
+  }
+
+  return 1;
+}
+
+// A surfaceless context where the driver offers one, the default display
+// otherwise.
+static int createContext(void) {
+  EGLDisplay display = EGL_NO_DISPLAY;
+
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay != NULL) {
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  EGLint major, minor;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+    printf("Failed to initialise EGL\n");
+    return 0;
+  }
+
+  eglBindAPI(EGL_OPENGL_API);
+
+  const EGLint attributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE,
+  };
+  EGLContext context = eglCreateContext(display, NULL, EGL_NO_CONTEXT, attributes);
+  if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    printf("Failed to create an OpenGL 3.3 core context (EGL error 0x%x)\n", eglGetError());
+    return 0;
+  }
+
+  gladLoadGL();
+  return 1;
+}
+
+static const unsigned char* pixel(const struct Image* image, float x, float y) {
+  int column = (int)((x * 0.5f + 0.5f) * image->size);
+  int row = (int)((y * 0.5f + 0.5f) * image->size);
+  return image->pixels + 4 * (row * image->size + column);
+}
+
+static int expect(const struct Image* image, float x, float y, const float* color, const char* what, size_t index) {
+  const unsigned char* actual = pixel(image, x, y);
+
+  for (int c = 0; c < 3; c++) {
+    if (abs(actual[c] - (int)lroundf(color[c] * 255.0f)) > 2) {
+      printf("%s %zu at (%.3f, %.3f): got %d %d %d, expected %.0f %.0f %.0f\n", what, index, x, y, actual[0], actual[1],
+             actual[2], color[0] * 255.0f, color[1] * 255.0f, color[2] * 255.0f);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void writeImage(const struct Image* image, const char* path) {
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    printf("Failed to open %s\n", path);
+    return;
+  }
+
+  // glReadPixels rows run bottom to top.
+  fprintf(file, "P6\n%d %d\n255\n", image->size, image->size);
+  for (int row = image->size - 1; row >= 0; row--) {
+    for (int column = 0; column < image->size; column++) {
+      fwrite(image->pixels + 4 * (row * image->size + column), 1, 3, file);
+    }
+  }
+
+  fclose(file);
+}
+
+static long fileSize(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    return -1;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+// Records the chain through a Capture and checks the output against image,
+// the same frame read back directly: a PPM pattern must reproduce the last
+// frame exactly, a Y4M stream must hold every frame.
+static int checkCapture(struct Renderer* renderer, const float* thetas, const struct Image* image, const char* path) {
+  int size = image->size;
+  struct Capture* capture = createCapture(size, size, 60, path);
+  if (capture == NULL) {
+    return 0;
+  }
+
+  for (int frame = 0; frame < CAPTURE_FRAMES; frame++) {
+    beginCapture(capture);
+    glClear(GL_COLOR_BUFFER_BIT);
+    memcpy(chainAngles(renderer), thetas, renderer->n * sizeof(float));
+    drawChain(renderer);
+    endCapture(capture);
+  }
+
+  int y4m = capture->y4m;
+  printf("Captured %lu frames, %.3f ms per frame on the render thread (%.3f ms fence, %.3f ms writer)\n",
+         capture->frames, capture->seconds * 1e3 / capture->frames, capture->fenceSeconds * 1e3 / capture->frames,
+         capture->stallSeconds * 1e3 / capture->frames);
+  destroyCapture(capture);
+
+  if (y4m) {
+    char header[64];
+    long expected = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", size, size) +
+                    CAPTURE_FRAMES * (6 + 3L * size * size);
+    long actual = fileSize(path);
+    if (actual != expected) {
+      printf("%s holds %ld bytes, expected %ld\n", path, actual, expected);
+      return 0;
+    }
+    return 1;
+  }
+
+  char last[1024];
+  snprintf(last, sizeof(last), path, CAPTURE_FRAMES - 1);
+  FILE* file = fopen(last, "rb");
+  if (file == NULL) {
+    printf("Failed to open %s\n", last);
+    return 0;
+  }
+
+  int width = 0, height = 0, mismatches = 0;
+  if (fscanf(file, "P6 %d %d 255", &width, &height) != 2 || fgetc(file) == EOF || width != size || height != size) {
+    printf("%s is not a %dx%d PPM\n", last, size, size);
+    fclose(file);
+    return 0;
+  }
+  for (int row = size - 1; row >= 0; row--) {
+    for (int column = 0; column < size; column++) {
+      unsigned char rgb[3];
+      if (fread(rgb, 1, 3, file) != 3 || memcmp(rgb, image->pixels + 4 * (row * size + column), 3) != 0) {
+        mismatches++;
+      }
+    }
+  }
+  fclose(file);
+
+  if (mismatches > 0) {
+    printf("%d pixels of %s differ from the direct read\n", mismatches, last);
+  }
+  return mismatches == 0;
+}
+
+int main(int argc, char** argv) {
+  struct Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    return 1;
+  }
+
+  if (!createContext()) {
+    return 1;
+  }
+  printf("%s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+  size_t n = options.links;
+  int size = options.size;
+
+  // A gentle curl that never crosses itself, so every probe below sees
+  // only the primitive it is aimed at.
+  float* thetas = (float*)malloc(n * sizeof(float));
+  float* lengths = (float*)malloc(n * sizeof(float));
+  float* radii = (float*)malloc(n * sizeof(float));
+  float* colors = (float*)malloc(3 * n * sizeof(float));
+  for (size_t i = 0; i < n; i++) {
+    thetas[i] = PI - 1.2f + 1.6f * i / n;
+    lengths[i] = 1.0f + 0.5f * (i % 2);
+    radii[i] = BOB_RADIUS * 6.0f / (n > 6 ? n : 6);
+    colors[3 * i + 0] = (float)((i + 1) % 2);
+    colors[3 * i + 1] = (float)((i + 1) / 2 % 2);
+    colors[3 * i + 2] = (float)((i + 1) / 4 % 2);
+  }
+
+  float chainLength = 0.0f;
+  for (size_t i = 0; i < n; i++) {
+    chainLength += lengths[i];
+  }
+  float scale = 1.5f / chainLength;
+
+  GLuint framebuffer, colorBuffer;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+  glViewport(0, 0, size, size);
+
+  // Without a loader the angle stream falls back to orphaning.
+  GLADloadproc load = options.orphan ? NULL : (GLADloadproc)eglGetProcAddress;
+  struct Renderer* renderer = createRenderer(n, lengths, radii, colors, ANCHOR_X, ANCHOR_Y, scale, load);
+  if (renderer == NULL) {
+    return 1;
+  }
+  printf("Streaming angles by %s\n", renderer->angles->mode == STREAM_PERSISTENT ? "persistent mapping" : "orphaning");
+
+  // Earlier frames draw a rotated chain, so a region read out of turn
+  // shows up in the probes.
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  for (int frame = 0; frame <= WARMUP_FRAMES; frame++) {
+    float* angles = chainAngles(renderer);
+    for (size_t i = 0; i < n; i++) {
+      angles[i] = thetas[i] + (frame < WARMUP_FRAMES ? 0.3f * (frame + 1) : 0.0f);
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    drawChain(renderer);
+  }
+
+  struct Image image = {size, (unsigned char*)malloc(4 * size * size)};
+  glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+
+  static const float grey[3] = {0.5f, 0.5f, 0.5f};
+  static const float black[3] = {0.0f, 0.0f, 0.0f};
+
+  // Bob centres carry the bob colour, rod midpoints are grey, and a corner
+  // of each bob's quad lies outside its disc. The corner probed is the one
+  // pointing furthest from both rods meeting at the bob.
+  int probes = 0, passed = 0;
+  float x = ANCHOR_X, y = ANCHOR_Y;
+  for (size_t i = 0; i < n; i++) {
+    float nextX = x + scale * lengths[i] * sinf(thetas[i]);
+    float nextY = y + scale * lengths[i] * cosf(thetas[i]);
+
+    passed += expect(&image, nextX, nextY, colors + 3 * i, "bob", i);
+    passed += expect(&image, 0.5f * (x + nextX), 0.5f * (y + nextY), grey, "rod", i);
+
+    float inX = -sinf(thetas[i]), inY = -cosf(thetas[i]);
+    float outX = i + 1 < n ? sinf(thetas[i + 1]) : inX;
+    float outY = i + 1 < n ? cosf(thetas[i + 1]) : inY;
+
+    float cornerX = 0, cornerY = 0, best = 2;
+    for (int corner = 0; corner < 4; corner++) {
+      float sx = corner & 1 ? 1.0f : -1.0f;
+      float sy = corner & 2 ? 1.0f : -1.0f;
+      float nearest = fmaxf(sx * inX + sy * inY, sx * outX + sy * outY);
+      if (nearest < best) {
+        best = nearest;
+        cornerX = nextX + 0.95f * sx * radii[i];
+        cornerY = nextY + 0.95f * sy * radii[i];
+      }
+    }
+    passed += expect(&image, cornerX, cornerY, black, "corner", i);
+    probes += 3;
+
+    x = nextX;
+    y = nextY;
+  }
+
+  if (options.output != NULL) {
+    writeImage(&image, options.output);
+  }
+
+  if (options.capture != NULL) {
+    passed += checkCapture(renderer, thetas, &image, options.capture);
+    probes++;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, size, size);
+  }
+
+  // Sample k sits at x = -0.9 + 1.8 k / (TRAIL_SAMPLES - 1) on the pixel
+  // row through trailY. Drawn vertex j is sample TRAIL_SAMPLES -
+  // TRAIL_CAPACITY + j with alpha (j + 1) / TRAIL_CAPACITY, so a segment
+  // midpoint carries the mean of its two ends.
+  static const float white[3] = {1.0f, 1.0f, 1.0f};
+  struct Trail* trail = createTrail(TRAIL_CAPACITY, white[0], white[1], white[2]);
+  if (trail == NULL) {
+    return 1;
+  }
+
+  float trailY = (size / 8 + 0.5f) / size * 2.0f - 1.0f;
+  for (int k = 0; k < TRAIL_SAMPLES; k++) {
+    appendTrail(trail, -0.9f + 1.8f * k / (TRAIL_SAMPLES - 1), trailY);
+  }
+
+  glClear(GL_COLOR_BUFFER_BIT);
+  drawTrail(trail);
+  glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+
+  int segments[] = {10, TRAIL_SAMPLES - TRAIL_CAPACITY / 2, TRAIL_SAMPLES - 2};
+  for (int s = 0; s < 3; s++) {
+    int k = segments[s];
+    int j = k - (TRAIL_SAMPLES - TRAIL_CAPACITY);
+    float alpha = j < 0 ? 0.0f : (j + 1.5f) / TRAIL_CAPACITY;
+    float faded[3] = {alpha, alpha, alpha};
+    float x = -0.9f + 1.8f * (k + 0.5f) / (TRAIL_SAMPLES - 1);
+    passed += expect(&image, x, trailY, faded, "trail segment", (size_t)k);
+    probes++;
+  }
+
+  destroyTrail(trail);
+
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR) {
+    printf("GL error 0x%x\n", error);
+  }
+
+  printf("%d of %d probes match for %zu links at %dx%d\n", passed, probes, n, size, size);
+  printf("%zu bytes per frame, %.3f ms fence wait over %lu frames\n", renderer->angles->lastBytes,
+         renderer->angles->waitSeconds * 1e3, renderer->angles->frames);
+
+  destroyRenderer(renderer);
+  glDeleteRenderbuffers(1, &colorBuffer);
+  glDeleteFramebuffers(1, &framebuffer);
+
+  free(image.pixels);
+  free(colors);
+  free(radii);
+  free(lengths);
+  free(thetas);
+
+  return passed == probes && error == GL_NO_ERROR ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "renderer.h"
+#include "shaders/shader.frag.h"
+#include "shaders/shader.vert.h"
+#include "shaders/trail.frag.h"
+#include "shaders/trail.vert.h"
+
+#define STRIP_VERTICES 4
+
+#define ROD_WIDTH 0.0075f
+
+// Texels per link in the static link buffer.
+#define LINK_TEXELS 2
+
+static GLuint compileShader(GLenum type, const GLchar* source, GLint length) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, length > 0 ? &length : NULL);
+  glCompileShader(shader);
+
+  GLint status;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (!status) {
+    char log[1024];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    printf("Failed to compile shader: %s\n", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+
+  return shader;
+}
+
+static GLuint linkProgram(const GLchar* vertexSource, GLint vertexLength, const GLchar* fragmentSource,
+                          GLint fragmentLength) {
+  GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource, vertexLength);
+  GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource, fragmentLength);
+  if (vertexShader == 0 || fragmentShader == 0) {
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertexShader);
+  glAttachShader(program, fragmentShader);
+  glLinkProgram(program);
+
+  glDeleteShader(vertexShader);
+  glDeleteShader(fragmentShader);
+
+  GLint status;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (!status) {
+    char log[1024];
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    printf("Failed to link shader program: %s\n", log);
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  return program;
+}
+
+struct Renderer* createRenderer(size_t n, const float* lengths, const float* radii, const float* colors, float anchorX,
+                                float anchorY, float scale, GLADloadproc load) {
+  GLuint program = linkProgram((const GLchar*)shaders_shader_vert, shaders_shader_vert_len,
+                               (const GLchar*)shaders_shader_frag, shaders_shader_frag_len);
+  if (program == 0) {
+    return NULL;
+  }
+
+  struct Renderer* renderer = (struct Renderer*)calloc(1, sizeof(struct Renderer));
+  renderer->n = n;
+  renderer->program = program;
+
+  float* links = (float*)calloc(n * LINK_TEXELS * 4, sizeof(float));
+  for (size_t i = 0; i < n; i++) {
+    float* texels = links + i * LINK_TEXELS * 4;
+    texels[0] = lengths[i] * scale;
+    texels[1] = radii[i];
+    memcpy(texels + 4, colors + 3 * i, 3 * sizeof(float));
+    texels[7] = 1.0f;
+  }
+
+  // Core profile draws need a vertex array object bound even with no
+  // attributes.
+  glGenVertexArrays(1, &renderer->vao);
+
+  renderer->angles = createStreamBuffer(GL_TEXTURE_BUFFER, n * sizeof(GLfloat), load);
+
+  glGenBuffers(1, &renderer->linkBuffer);
+  glBindBuffer(GL_TEXTURE_BUFFER, renderer->linkBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, n * LINK_TEXELS * 4 * sizeof(GLfloat), links, GL_STATIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  free(links);
+
+  glGenTextures(1, &renderer->angleTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, renderer->angleTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, renderer->angles->buffer);
+
+  glGenTextures(1, &renderer->linkTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, renderer->linkTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, renderer->linkBuffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+  // Apart from the angle base, uniforms never change, so they are set once
+  // here.
+  renderer->angleBaseLocation = glGetUniformLocation(program, "uAngleBase");
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "uAngles"), 0);
+  glUniform1i(glGetUniformLocation(program, "uLinks"), 1);
+  glUniform1i(glGetUniformLocation(program, "uLinkCount"), (GLint)n);
+  glUniform2f(glGetUniformLocation(program, "uAnchor"), anchorX, anchorY);
+  glUniform1f(glGetUniformLocation(program, "uRodWidth"), ROD_WIDTH);
+  glUseProgram(0);
+
+  return renderer;
+}
+
+void destroyRenderer(struct Renderer* renderer) {
+  if (renderer == NULL) {
+    return;
+  }
+
+  glDeleteTextures(1, &renderer->linkTexture);
+  glDeleteTextures(1, &renderer->angleTexture);
+  glDeleteBuffers(1, &renderer->linkBuffer);
+  destroyStreamBuffer(renderer->angles);
+  glDeleteVertexArrays(1, &renderer->vao);
+  glDeleteProgram(renderer->program);
+
+  free(renderer);
+}
+
+float* chainAngles(struct Renderer* renderer) {
+  float* angles = (float*)beginStream(renderer->angles);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  return angles;
+}
+
+void drawChain(struct Renderer* renderer) {
+  size_t n = renderer->n;
+
+  endStream(renderer->angles, n * sizeof(GLfloat));
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, renderer->angleTexture);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_BUFFER, renderer->linkTexture);
+
+  // Rods are the first n instances, so every bob lands on top of them.
+  glUseProgram(renderer->program);
+  glUniform1i(renderer->angleBaseLocation, (GLint)(streamOffset(renderer->angles) / sizeof(GLfloat)));
+  glBindVertexArray(renderer->vao);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, STRIP_VERTICES, (GLsizei)(2 * n));
+  fenceStream(renderer->angles);
+
+  glBindVertexArray(0);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+struct Trail* createTrail(size_t capacity, float r, float g, float b) {
+  GLuint program = linkProgram((const GLchar*)shaders_trail_vert, shaders_trail_vert_len,
+                               (const GLchar*)shaders_trail_frag, shaders_trail_frag_len);
+  if (program == 0) {
+    return NULL;
+  }
+
+  struct Trail* trail = (struct Trail*)calloc(1, sizeof(struct Trail));
+  trail->capacity = capacity;
+  trail->program = program;
+
+  glGenVertexArrays(1, &trail->vao);
+
+  glGenBuffers(1, &trail->pointBuffer);
+  glBindBuffer(GL_TEXTURE_BUFFER, trail->pointBuffer);
+  glBufferData(GL_TEXTURE_BUFFER, capacity * 2 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  glGenTextures(1, &trail->pointTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, trail->pointTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, trail->pointBuffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+  trail->headLocation = glGetUniformLocation(program, "uHead");
+  trail->countLocation = glGetUniformLocation(program, "uCount");
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "uPoints"), 0);
+  glUniform1i(glGetUniformLocation(program, "uCapacity"), (GLint)capacity);
+  glUniform3f(glGetUniformLocation(program, "uColor"), r, g, b);
+  glUseProgram(0);
+
+  return trail;
+}
+
+void destroyTrail(struct Trail* trail) {
+  if (trail == NULL) {
+    return;
+  }
+
+  glDeleteTextures(1, &trail->pointTexture);
+  glDeleteBuffers(1, &trail->pointBuffer);
+  glDeleteVertexArrays(1, &trail->vao);
+  glDeleteProgram(trail->program);
+
+  free(trail);
+}
+
+void appendTrail(struct Trail* trail, float x, float y) {
+  GLfloat point[2] = {x, y};
+
+  glBindBuffer(GL_TEXTURE_BUFFER, trail->pointBuffer);
+  glBufferSubData(GL_TEXTURE_BUFFER, trail->head * sizeof(point), sizeof(point), point);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  trail->head = (trail->head + 1) % trail->capacity;
+  if (trail->count < trail->capacity) {
+    trail->count++;
+  }
+}
+
+// Old samples stay in the buffer but are never drawn again.
+void clearTrail(struct Trail* trail) {
+  trail->count = 0;
+  trail->head = 0;
+}
+
+void drawTrail(struct Trail* trail) {
+  if (trail->count < 2) {
+    return;
+  }
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, trail->pointTexture);
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  glUseProgram(trail->program);
+  glUniform1i(trail->headLocation, (GLint)trail->head);
+  glUniform1i(trail->countLocation, (GLint)trail->count);
+  glBindVertexArray(trail->vao);
+  glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)trail->count);
+
+  glBindVertexArray(0);
+  glDisable(GL_BLEND);
+}
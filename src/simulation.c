@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profiler.h"
+#include "simulation.h"
+
+// The middle word holds a slot index and whether the writer has put
+// something there the reader has not taken yet.
+#define SLOT_MASK 3u
+#define FRESH 4u
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sleepFor(double seconds) {
+  struct timespec ts;
+  ts.tv_sec = (time_t)seconds;
+  ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+  nanosleep(&ts, NULL);
+}
+
+// Fills the writer's back slot from the current state and the one a step
+// before it.
+static void capture(struct Simulation* simulation, double time, double lag, unsigned long step) {
+  struct Snapshot* snapshot = &simulation->slots[simulation->back];
+  size_t n = simulation->n;
+
+  snapshot->time = time;
+  snapshot->lag = lag;
+  snapshot->step = step;
+  memcpy(snapshot->thetas, simulation->thetas, n * sizeof(float));
+  memcpy(snapshot->omegas, simulation->omegas, n * sizeof(float));
+  memcpy(snapshot->previousThetas, simulation->previousThetas, n * sizeof(float));
+}
+
+// Release orders the slot's contents before the index that names it.
+static void publish(struct Simulation* simulation) {
+  unsigned previous = atomic_exchange_explicit(&simulation->middle, simulation->back | FRESH, memory_order_acq_rel);
+  simulation->back = previous & SLOT_MASK;
+}
+
+struct Simulation* createSimulation(struct Integrator* integrator, float dt, const float* thetas, const float* omegas) {
+  size_t n = integrator->ws->n;
+
+  struct Simulation* simulation = (struct Simulation*)calloc(1, sizeof(struct Simulation));
+  simulation->integrator = integrator;
+  simulation->n = n;
+  simulation->dt = dt;
+  simulation->maxSubsteps = SIMULATION_MAX_SUBSTEPS;
+
+  simulation->thetas = (float*)malloc(n * sizeof(float));
+  simulation->omegas = (float*)malloc(n * sizeof(float));
+  simulation->previousThetas = (float*)malloc(n * sizeof(float));
+  memcpy(simulation->thetas, thetas, n * sizeof(float));
+  memcpy(simulation->omegas, omegas, n * sizeof(float));
+  memcpy(simulation->previousThetas, thetas, n * sizeof(float));
+
+  for (int s = 0; s < 3; s++) {
+    struct Snapshot* snapshot = &simulation->slots[s];
+    snapshot->thetas = (float*)calloc(n, sizeof(float));
+    snapshot->omegas = (float*)calloc(n, sizeof(float));
+    snapshot->previousThetas = (float*)calloc(n, sizeof(float));
+  }
+
+  // The reader starts on slot 0 holding the initial state, the writer on 1.
+  simulation->front = 0;
+  simulation->back = 0;
+  capture(simulation, 0.0, 0.0, 0);
+  simulation->back = 1;
+  atomic_init(&simulation->middle, 2);
+
+  atomic_init(&simulation->running, 0);
+  atomic_init(&simulation->steps, 0);
+  atomic_init(&simulation->batches, 0);
+  atomic_init(&simulation->droppedSteps, 0);
+  atomic_init(&simulation->busyNanoseconds, 0);
+
+  return simulation;
+}
+
+void destroySimulation(struct Simulation* simulation) {
+  if (simulation == NULL) {
+    return;
+  }
+
+  stopSimulation(simulation);
+
+  for (int s = 0; s < 3; s++) {
+    free(simulation->slots[s].previousThetas);
+    free(simulation->slots[s].omegas);
+    free(simulation->slots[s].thetas);
+  }
+
+  free(simulation->previousThetas);
+  free(simulation->omegas);
+  free(simulation->thetas);
+  free(simulation);
+}
+
+// A fixed-step accumulator against the wall clock. Simulated time only
+// ever advances in whole steps of dt, so results do not depend on how
+// often the thread wakes. When more than maxSubsteps steps are due at once
+// (the integrator cannot keep up, or the process was suspended) the excess
+// is added to lag and skipped, so a slow step never snowballs into an
+// ever longer catch-up.
+static void* simulationMain(void* argument) {
+  struct Simulation* simulation = (struct Simulation*)argument;
+  size_t n = simulation->n;
+  double dt = simulation->dt;
+
+  double time = 0, lag = 0;
+  unsigned long step = 0;
+
+  PROFILE_THREAD("physics");
+
+  while (atomic_load_explicit(&simulation->running, memory_order_relaxed)) {
+    double wall = now() - simulation->start - lag;
+    double ahead = time + dt - wall;
+    if (ahead > 0) {
+      sleepFor(ahead);
+      continue;
+    }
+
+    long due = (long)((wall - time) / dt);
+    if (due < 1) {
+      due = 1;
+    }
+    if (due > simulation->maxSubsteps) {
+      long dropped = due - simulation->maxSubsteps;
+      lag += dropped * dt;
+      due = simulation->maxSubsteps;
+      atomic_fetch_add_explicit(&simulation->droppedSteps, dropped, memory_order_relaxed);
+    }
+
+    double begin = now();
+    for (long substep = 0; substep < due; substep++) {
+      if (substep == due - 1) {
+        memcpy(simulation->previousThetas, simulation->thetas, n * sizeof(float));
+      }
+      PROFILE_SCOPE(ZONE_STEP) {
+        integrate(simulation->integrator, simulation->dt, simulation->thetas, simulation->omegas);
+      }
+    }
+    step += due;
+    time = step * dt;
+
+    capture(simulation, time, lag, step);
+    publish(simulation);
+
+    atomic_fetch_add_explicit(&simulation->busyNanoseconds, (unsigned long)((now() - begin) * 1e9), memory_order_relaxed);
+    atomic_fetch_add_explicit(&simulation->steps, due, memory_order_relaxed);
+    atomic_fetch_add_explicit(&simulation->batches, 1, memory_order_relaxed);
+  }
+
+  return NULL;
+}
+
+int startSimulation(struct Simulation* simulation) {
+  simulation->start = now();
+  atomic_store(&simulation->running, 1);
+
+  if (pthread_create(&simulation->thread, NULL, simulationMain, simulation) != 0) {
+    printf("Failed to start the simulation thread\n");
+    atomic_store(&simulation->running, 0);
+    return 0;
+  }
+
+  return 1;
+}
+
+void stopSimulation(struct Simulation* simulation) {
+  if (!atomic_exchange(&simulation->running, 0)) {
+    return;
+  }
+
+  pthread_join(simulation->thread, NULL);
+}
+
+// Acquire pairs with publish(), so the slot's contents are visible once its
+// index is.
+const struct Snapshot* latestSnapshot(struct Simulation* simulation) {
+  if (atomic_load_explicit(&simulation->middle, memory_order_relaxed) & FRESH) {
+    unsigned previous = atomic_exchange_explicit(&simulation->middle, (unsigned)simulation->front, memory_order_acq_rel);
+    simulation->front = previous & SLOT_MASK;
+  }
+
+  return &simulation->slots[simulation->front];
+}
+
+float interpolationWeight(const struct Simulation* simulation, const struct Snapshot* snapshot) {
+  double dt = simulation->dt;
+  double target = now() - simulation->start - snapshot->lag - dt;
+  double weight = (target - (snapshot->time - dt)) / dt;
+
+  if (weight < 0) {
+    return 0.0f;
+  }
+  if (weight > 1) {
+    return 1.0f;
+  }
+  return (float)weight;
+}
@@ -0,0 +1,145 @@
+#include <math.h>
+
+#include "physics.h"
+#include "specialized.h"
+
+// The classic double pendulum. With c = cos(t0 - t1), s = sin(t0 - t1),
+// the weights W and the gravity moments G_i = mu_i l_i, the system
+// M alpha = B is
+//   [W00     W01 c] [a0]   [-W01 w1^2 s - G0 g sin t0]
+//   [W01 c   W11  ] [a1] = [ W01 w0^2 s - G1 g sin t1]
+// and Cramer's rule solves it with one division. For unit masses and
+// lengths W = [[2, 1], [1, 1]] and G = (2, 1).
+static void accelerations2(const struct Workspace* ws, const float* thetas, const float* omegas, float* alphas) {
+  const float* W = ws->weights;
+  const float* moments = ws->suffixMoments;
+  float w00 = W[0], w01 = W[1], w11 = W[3];
+
+  float delta = thetas[0] - thetas[1];
+  float s = sinf(delta);
+  float c = cosf(delta);
+
+  float b0 = -w01 * omegas[1] * omegas[1] * s - moments[0] * GRAVITY * sinf(thetas[0]);
+  float b1 = w01 * omegas[0] * omegas[0] * s - moments[1] * GRAVITY * sinf(thetas[1]);
+
+  float inverse = 1.0f / (w00 * w11 - w01 * w01 * c * c);
+  alphas[0] = (w11 * b0 - w01 * c * b1) * inverse;
+  alphas[1] = (w00 * b1 - w01 * c * b0) * inverse;
+}
+
+// assembleSystem() followed by ldlt_decompose() and ldlt_substitution(), for
+// a compile-time n. Only the lower triangle of A is formed. Always inlined
+// into the fixed-length wrappers below, where n is a constant and the
+// workspace weights are read with constant offsets.
+static inline __attribute__((always_inline)) void fixedAccelerations(const int n, const struct Workspace* ws, const float* thetas, const float* omegas, float* alphas) {
+  const float* W = ws->weights;
+  const float* moments = ws->suffixMoments;
+
+  float s[SPECIALIZED_MAX_N], c[SPECIALIZED_MAX_N];
+  float omegaS[SPECIALIZED_MAX_N], omegaC[SPECIALIZED_MAX_N];
+  float A[SPECIALIZED_MAX_N][SPECIALIZED_MAX_N];
+  float x[SPECIALIZED_MAX_N];
+
+#pragma GCC unroll 8
+  for (int i = 0; i < n; i++) {
+    s[i] = sinf(thetas[i]);
+    c[i] = cosf(thetas[i]);
+    omegaS[i] = omegas[i] * omegas[i] * s[i];
+    omegaC[i] = omegas[i] * omegas[i] * c[i];
+  }
+
+#pragma GCC unroll 8
+  for (int i = 0; i < n; i++) {
+    float sumC = 0, sumS = 0;
+#pragma GCC unroll 8
+    for (int j = 0; j < n; j++) {
+      float weight = W[i * n + j];
+      if (j <= i) {
+        A[i][j] = weight * (c[i] * c[j] + s[i] * s[j]);
+      }
+      sumC += weight * omegaC[j];
+      sumS += weight * omegaS[j];
+    }
+    x[i] = -s[i] * sumC + c[i] * sumS - moments[i] * GRAVITY * s[i];
+  }
+
+#pragma GCC unroll 8
+  for (int j = 0; j < n; j++) {
+#pragma GCC unroll 8
+    for (int k = 0; k < j; k++) {
+      float sum = 0;
+#pragma GCC unroll 8
+      for (int m = 0; m < k; m++) {
+        sum += A[j][m] * A[k][m];
+      }
+      A[j][k] -= sum;
+    }
+
+    float d = A[j][j];
+#pragma GCC unroll 8
+    for (int k = 0; k < j; k++) {
+      float l = A[j][k] / A[k][k];
+      d -= l * A[j][k];
+      A[j][k] = l;
+    }
+    A[j][j] = d;
+  }
+
+#pragma GCC unroll 8
+  for (int i = 0; i < n; i++) {
+#pragma GCC unroll 8
+    for (int k = 0; k < i; k++) {
+      x[i] -= A[i][k] * x[k];
+    }
+  }
+
+#pragma GCC unroll 8
+  for (int i = 0; i < n; i++) {
+    x[i] /= A[i][i];
+  }
+
+#pragma GCC unroll 8
+  for (int k = n - 1; k >= 0; k--) {
+#pragma GCC unroll 8
+    for (int i = 0; i < k; i++) {
+      x[i] -= A[k][i] * x[k];
+    }
+  }
+
+#pragma GCC unroll 8
+  for (int i = 0; i < n; i++) {
+    alphas[i] = x[i];
+  }
+}
+
+#define SPECIALIZE(N) \
+  static void accelerations##N(const struct Workspace* ws, const float* thetas, const float* omegas, float* alphas) { \
+    fixedAccelerations(N, ws, thetas, omegas, alphas); \
+  }
+
+SPECIALIZE(3)
+SPECIALIZE(4)
+SPECIALIZE(5)
+SPECIALIZE(6)
+SPECIALIZE(7)
+SPECIALIZE(8)
+
+static void (*const specialized[SPECIALIZED_MAX_N + 1])(const struct Workspace*, const float*, const float*, float*) = {
+  [2] = accelerations2,
+  [3] = accelerations3,
+  [4] = accelerations4,
+  [5] = accelerations5,
+  [6] = accelerations6,
+  [7] = accelerations7,
+  [8] = accelerations8,
+};
+
+int specializedAccelerations(const struct Workspace* ws, const float* thetas, const float* omegas, float* alphas) {
+  size_t n = ws->n;
+  if (n < SPECIALIZED_MIN_N || n > SPECIALIZED_MAX_N) {
+    return 0;
+  }
+
+  specialized[n](ws, thetas, omegas, alphas);
+  return 1;
+}
@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "lyapunov.h"
+#include "physics.h"
+
+// Lyapunov exponents of the chain main.c animates, without a window. The
+// chain is Hamiltonian, so the full spectrum comes in +/- pairs and sums to
+// zero up to integration error, which makes a handy self-check.
+
+#define DEFAULT_LINKS 2
+#define DEFAULT_SECONDS 200.0f
+#define DEFAULT_STEP 0.005f
+
+#define PI 3.14159265358979323846f
+
+#define DEFAULT_THETA (3 * PI / 4.0f)
+#define DEFAULT_OMEGA 0.9f
+
+struct Options {
+  size_t links;
+  int count;
+  float seconds;
+  float dt;
+  int interval;
+  enum Engine engine;
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char* program) {
+  printf("usage: %s [-n links] [-k exponents, 0 for all] [-t seconds] [-d dt] [-r steps per QR] [-e lu|cholesky]\n", program);
+}
+
+static int parseOptions(int argc, char** argv, struct Options* options) {
+  options->links = DEFAULT_LINKS;
+  options->count = 0;
+  options->seconds = DEFAULT_SECONDS;
+  options->dt = DEFAULT_STEP;
+  options->interval = LYAPUNOV_RENORMALIZE_STEPS;
+  options->engine = ENGINE_CHOLESKY;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+      usage(argv[0]);
+      return 0;
+    }
+
+    const char* value = argv[++i];
+
+    switch (argv[i - 1][1]) {
+      case 'n':
+        options->links = strtoul(value, NULL, 10);
+        break;
+      case 'k':
+        options->count = atoi(value);
+        break;
+      case 't':
+        options->seconds = strtof(value, NULL);
+        break;
+      case 'd':
+        options->dt = strtof(value, NULL);
+        break;
+      case 'r':
+        options->interval = atoi(value);
+        break;
+      case 'e':
+        if (strcmp(value, "lu") == 0) {
+          options->engine = ENGINE_LU;
+        } else if (strcmp(value, "cholesky") == 0) {
+          options->engine = ENGINE_CHOLESKY;
+        } else {
+          printf("Unknown engine: %s\n", value);
+          return 0;
+        }
+        break;
+      default:
+        usage(argv[0]);
+        return 0;
+    }
+  }
+
+  if (options->links == 0 || options->seconds <= 0 || options->dt <= 0 || options->interval <= 0) {
+    usage(argv[0]);
+    return 0;
+  }
+
+  if (options->count <= 0) {
+    options->count = (int)(2 * options->links);
+  }
+
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  struct Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    return 1;
+  }
+
+  size_t n = options.links;
+  struct Workspace* ws = createWorkspace(n, options.engine);
+  struct Lyapunov* lyapunov = createLyapunov(ws, options.count);
+  if (lyapunov == NULL) {
+    destroyWorkspace(ws);
+    return 1;
+  }
+  lyapunov->interval = options.interval;
+
+  float* thetas = (float*)malloc(n * sizeof(float));
+  float* omegas = (float*)malloc(n * sizeof(float));
+  double* exponents = (double*)malloc(options.count * sizeof(double));
+  for (size_t i = 0; i < n; i++) {
+    thetas[i] = DEFAULT_THETA;
+    omegas[i] = DEFAULT_OMEGA;
+  }
+
+  long steps = (long)(options.seconds / options.dt);
+  double start = now();
+  for (long step = 0; step < steps; step++) {
+    lyapunovStep(lyapunov, options.dt, thetas, omegas);
+  }
+  double elapsed = now() - start;
+
+  lyapunovExponents(lyapunov, exponents);
+
+  printf("links %zu, %.4g s at dt %g, QR every %d steps\n", n, lyapunov->time, options.dt, options.interval);
+
+  double sum = 0;
+  for (int v = 0; v < options.count; v++) {
+    printf("lambda_%-3d %12.5f\n", v + 1, exponents[v]);
+    sum += exponents[v];
+  }
+  if (options.count == (int)(2 * n)) {
+    printf("sum        %12.5f\n", sum);
+  }
+
+  printf("%.3g s wall, %.4g us/step with %d tangent vectors\n", elapsed, elapsed * 1e6 / steps, options.count);
+
+  free(exponents);
+  free(omegas);
+  free(thetas);
+  destroyLyapunov(lyapunov);
+  destroyWorkspace(ws);
+  return 0;
+}
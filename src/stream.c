@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stream.h"
+
+// Buffer storage is GL 4.4, past what glad was generated for.
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// Waits are polled in slices this long, so a stalled GPU shows up as wait
+// time rather than a hang.
+#define FENCE_TIMEOUT_NS 1000000
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int hasBufferStorage(void) {
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major > 4 || (major == 4 && minor >= 4)) {
+    return 1;
+  }
+
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++) {
+    if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+struct StreamBuffer* createStreamBuffer(GLenum target, size_t regionSize, GLADloadproc load) {
+  struct StreamBuffer* stream = (struct StreamBuffer*)calloc(1, sizeof(struct StreamBuffer));
+  stream->target = target;
+  stream->regionSize = regionSize;
+  stream->region = STREAM_REGIONS - 1;
+  stream->mode = STREAM_ORPHAN;
+
+  glGenBuffers(1, &stream->buffer);
+  glBindBuffer(target, stream->buffer);
+
+  PFNGLBUFFERSTORAGEPROC bufferStorage = NULL;
+  if (load != NULL && hasBufferStorage()) {
+    bufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+  }
+
+  if (bufferStorage != NULL) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr size = (GLsizeiptr)(STREAM_REGIONS * regionSize);
+    bufferStorage(target, size, NULL, flags);
+    stream->mapped = (unsigned char*)glMapBufferRange(target, 0, size, flags);
+    if (stream->mapped != NULL) {
+      stream->mode = STREAM_PERSISTENT;
+    } else {
+      // Storage is immutable once allocated, so start over on a new name.
+      glDeleteBuffers(1, &stream->buffer);
+      glGenBuffers(1, &stream->buffer);
+      glBindBuffer(target, stream->buffer);
+    }
+  }
+
+  if (stream->mode == STREAM_ORPHAN) {
+    glBufferData(target, (GLsizeiptr)regionSize, NULL, GL_STREAM_DRAW);
+  }
+
+  return stream;
+}
+
+void destroyStreamBuffer(struct StreamBuffer* stream) {
+  if (stream == NULL) {
+    return;
+  }
+
+  for (int r = 0; r < STREAM_REGIONS; r++) {
+    if (stream->fences[r] != NULL) {
+      glDeleteSync(stream->fences[r]);
+    }
+  }
+
+  if (stream->mode == STREAM_PERSISTENT) {
+    glBindBuffer(stream->target, stream->buffer);
+    glUnmapBuffer(stream->target);
+  }
+  glDeleteBuffers(1, &stream->buffer);
+
+  free(stream);
+}
+
+void* beginStream(struct StreamBuffer* stream) {
+  glBindBuffer(stream->target, stream->buffer);
+
+  if (stream->mode == STREAM_ORPHAN) {
+    glBufferData(stream->target, (GLsizeiptr)stream->regionSize, NULL, GL_STREAM_DRAW);
+    stream->lastWaitSeconds = 0;
+    return glMapBufferRange(stream->target, 0, (GLsizeiptr)stream->regionSize,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  }
+
+  stream->region = (stream->region + 1) % STREAM_REGIONS;
+
+  double start = now();
+  GLsync fence = stream->fences[stream->region];
+  if (fence != NULL) {
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS) == GL_TIMEOUT_EXPIRED) {
+    }
+    glDeleteSync(fence);
+    stream->fences[stream->region] = NULL;
+  }
+  stream->lastWaitSeconds = now() - start;
+
+  return stream->mapped + stream->region * stream->regionSize;
+}
+
+// Coherent mappings need no flush; the orphaned store is unmapped so the
+// draw may read it.
+void endStream(struct StreamBuffer* stream, size_t bytes) {
+  if (stream->mode == STREAM_ORPHAN) {
+    glBindBuffer(stream->target, stream->buffer);
+    glUnmapBuffer(stream->target);
+  }
+
+  stream->frames++;
+  stream->bytes += bytes;
+  stream->waitSeconds += stream->lastWaitSeconds;
+  stream->lastBytes = bytes;
+}
+
+void fenceStream(struct StreamBuffer* stream) {
+  if (stream->mode == STREAM_PERSISTENT) {
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+}
+
+size_t streamOffset(const struct StreamBuffer* stream) {
+  return stream->mode == STREAM_PERSISTENT ? stream->region * stream->regionSize : 0;
+}
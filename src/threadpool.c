@@ -0,0 +1,261 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "threadpool.h"
+
+#define CACHE_LINE 64
+
+// A Chase-Lev deque specialised to one job: the tasks it holds are always
+// the contiguous run [top, bottom), so the indices are the tasks and no
+// storage is needed. Nothing is pushed once a job is running, which leaves
+// only the owner's pop and the thieves' steal to race over the last task.
+struct Deque {
+  _Alignas(CACHE_LINE) atomic_long top;
+  _Alignas(CACHE_LINE) atomic_long bottom;
+};
+
+struct Worker {
+  struct ThreadPool* pool;
+  int index;
+  pthread_t thread;
+  double partial;
+};
+
+struct ThreadPool {
+  int workers;
+  int deterministic;
+
+  struct Deque* deques;
+  struct Worker* threads;
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  unsigned long generation;
+  int stopping;
+  atomic_int busy;
+
+  TaskFunction function;
+  ReduceFunction reduce;
+  void* context;
+  double* partials;
+  size_t partialCapacity;
+};
+
+static long popTask(struct Deque* deque) {
+  long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  if (t > b) {
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return -1;
+  }
+
+  if (t == b) {
+    int won = atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return won ? b : -1;
+  }
+
+  return b;
+}
+
+// Returns -1 when the deque is empty and -2 when another thief won the race.
+static long stealTask(struct Deque* deque) {
+  long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+  if (t >= b) {
+    return -1;
+  }
+
+  if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+    return -2;
+  }
+
+  return t;
+}
+
+static void runTask(struct ThreadPool* pool, struct Worker* worker, size_t task) {
+  if (pool->function != NULL) {
+    pool->function(pool->context, task, worker->index);
+    return;
+  }
+
+  double value = pool->reduce(pool->context, task, worker->index);
+  if (pool->deterministic) {
+    pool->partials[task] = value;
+  } else {
+    worker->partial += value;
+  }
+}
+
+static void drainJob(struct ThreadPool* pool, struct Worker* worker) {
+  struct Deque* own = &pool->deques[worker->index];
+
+  for (;;) {
+    long task = popTask(own);
+
+    // Sweep the other deques until one yields a task or all are empty.
+    for (int attempt = 1; task < 0 && attempt <= pool->workers; attempt++) {
+      struct Deque* victim = &pool->deques[(worker->index + attempt) % pool->workers];
+      do {
+        task = stealTask(victim);
+      } while (task == -2);
+    }
+
+    if (task < 0) {
+      return;
+    }
+
+    runTask(pool, worker, (size_t)task);
+  }
+}
+
+static void* workerMain(void* argument) {
+  struct Worker* worker = (struct Worker*)argument;
+  struct ThreadPool* pool = worker->pool;
+  unsigned long seen = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->generation == seen && !pool->stopping) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    seen = pool->generation;
+    int stopping = pool->stopping;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (stopping) {
+      return NULL;
+    }
+
+    drainJob(pool, worker);
+    atomic_fetch_sub_explicit(&pool->busy, 1, memory_order_release);
+  }
+}
+
+int hardwareThreads(void) {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (int)count : 1;
+}
+
+struct ThreadPool* createThreadPool(int workers, int deterministic) {
+  if (workers <= 0) {
+    workers = hardwareThreads();
+  }
+
+  struct ThreadPool* pool = (struct ThreadPool*)calloc(1, sizeof(struct ThreadPool));
+  pool->workers = workers;
+  pool->deterministic = deterministic;
+
+  pool->deques = (struct Deque*)aligned_alloc(CACHE_LINE, workers * sizeof(struct Deque));
+  pool->threads = (struct Worker*)calloc(workers, sizeof(struct Worker));
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+
+  for (int w = 0; w < workers; w++) {
+    atomic_init(&pool->deques[w].top, 0);
+    atomic_init(&pool->deques[w].bottom, 0);
+
+    pool->threads[w].pool = pool;
+    pool->threads[w].index = w;
+    if (w > 0) {
+      pthread_create(&pool->threads[w].thread, NULL, workerMain, &pool->threads[w]);
+    }
+  }
+
+  return pool;
+}
+
+void destroyThreadPool(struct ThreadPool* pool) {
+  if (pool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = 1;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (int w = 1; w < pool->workers; w++) {
+    pthread_join(pool->threads[w].thread, NULL);
+  }
+
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+
+  free(pool->partials);
+  free(pool->threads);
+  free(pool->deques);
+  free(pool);
+}
+
+int threadPoolWorkers(const struct ThreadPool* pool) {
+  return pool->workers;
+}
+
+static void runJob(struct ThreadPool* pool, size_t tasks) {
+  for (int w = 0; w < pool->workers; w++) {
+    atomic_store_explicit(&pool->deques[w].top, (long)(tasks * w / pool->workers), memory_order_relaxed);
+    atomic_store_explicit(&pool->deques[w].bottom, (long)(tasks * (w + 1) / pool->workers), memory_order_relaxed);
+    pool->threads[w].partial = 0;
+  }
+
+  atomic_store_explicit(&pool->busy, pool->workers - 1, memory_order_relaxed);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->generation++;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+
+  drainJob(pool, &pool->threads[0]);
+
+  while (atomic_load_explicit(&pool->busy, memory_order_acquire) > 0) {
+    sched_yield();
+  }
+}
+
+void parallelFor(struct ThreadPool* pool, size_t tasks, TaskFunction function, void* context) {
+  pool->function = function;
+  pool->reduce = NULL;
+  pool->context = context;
+
+  runJob(pool, tasks);
+}
+
+double parallelReduce(struct ThreadPool* pool, size_t tasks, ReduceFunction function, void* context) {
+  if (pool->deterministic && pool->partialCapacity < tasks) {
+    free(pool->partials);
+    pool->partials = (double*)malloc(tasks * sizeof(double));
+    pool->partialCapacity = tasks;
+  }
+
+  pool->function = NULL;
+  pool->reduce = function;
+  pool->context = context;
+
+  runJob(pool, tasks);
+
+  double total = 0;
+  if (pool->deterministic) {
+    for (size_t t = 0; t < tasks; t++) {
+      total += pool->partials[t];
+    }
+  } else {
+    for (int w = 0; w < pool->workers; w++) {
+      total += pool->threads[w].partial;
+    }
+  }
+
+  return total;
+}